@@ -24,33 +24,85 @@ SOFTWARE.
 
 #include "localClock.h"
 #include "channelObject.h"
+#include "timeWarp.h"
+#include "tracer.h"
+#include "sharedMemory.h"
 #include "assert.h"
-#include <sys/time.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <time.h>
+#include <string.h>
 #include "simulator_types.h"
 
 
-#define channelObject_datagramSize(co) ((co)->messageSize+8)
+/// Size of the header of the events in the ringbuffer
+#define channelObject_headerSize(co) ((co)->variableLength?CHANNEL_OBJECT_VARIABLE_HEADER_SIZE:CHANNEL_OBJECT_HEADER_SIZE)
+/// Size of the largest event in the ringbuffer: the header and messageSize bytes of payload
+#define channelObject_datagramSize(co) ((co)->messageSize+channelObject_headerSize(co))
+/// The source clock is in optimistic mode: inserted events are sent speculatively or buffered until the step generating them is committed (see timeWarp.h)
+#define channelObject_isSpeculative(co) (channelObject_getClock(co)->timeWarp!=NULL && !channelObject_getClock(co)->timeWarp->committing)
+/// Buffer of the reader to copy the events wrapping around the end of the ringbuffer into
+#define channelObjectSink_readBuffer(sink) relativePtr_get((sink)->readBuffer, uint8_t)
+/// Copy the inserted event into the trace of the source clock (see tracer.h)
+#define channelObject_trace(co, timestamp, data, size) do{ if((co)->traceId!=0 && channelObject_getClock(co)->tracer!=NULL) \
+  tracer_traceEvent(channelObject_getClock(co)->tracer, (co)->traceId, (timestamp), (data), (size)); }while(0)
 
-/// State of simulator busy wait cycles
+/// Busy wait loops only check the exit flag and the elapsed time in every BUSY_WAIT_CHECK_INTERVAL-th iteration. Must be a power of 2.
+#define BUSY_WAIT_CHECK_INTERVAL 256
+
+/// State of simulator busy wait cycles. Thread local so that multiple clocks can be simulated by the threads of a process (see localClock_startThread()).
 
 /// Current target wait time measured in global clock ticks.
-static uint64_t currentTarget;
-/// Timestamp (of operating system real time) when waiting for other simulators started.
-static uint64_t startWaitAtMillis;
+static _Thread_local uint64_t currentTarget;
+/// Timestamp (of operating system monotonic time) when waiting for other simulators started. 0 means the current wait cycle was not checked yet.
+static _Thread_local uint64_t startWaitAtMillis;
 /// Store whether the current wait cycle reached the timeout to be logged to stderr.
-static bool wasLogged=false;
+static _Thread_local bool wasLogged=false;
+/// Number of iterations of the current wait cycle
+static _Thread_local uint32_t spinCount;
 
 
-/// Millisecond timestamp getter (CPU time) used to log too long waiting periods of the simulator.
+/// Millisecond timestamp getter (coarse monotonic time - cheap to read) used to log too long waiting periods of the simulator.
 static uint64_t current_millis();
 /// Called by the simulator from the inside of busy loops waiting for other processes.
-/// Detects too long wait periods and emits log messages to stderr in these cases.
-static void busyWaitIterate(uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName);
+/// Relaxes the CPU and calls busyWaitCheck() in every BUSY_WAIT_CHECK_INTERVAL-th iteration.
+static inline void busyWaitIterate(localClock_t * clock, uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName);
+/// Check the exit flag of the clock. Detects too long wait periods and emits log messages to stderr in these cases.
+static void busyWaitCheck(localClock_t * clock, uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName);
 /// Must be called after the busyWaitIterate cycles to signal that execution goes on.
 static void busyWaitDone(uint64_t availableTimestamp, uint64_t targetTimestamp);
+/// Set simulatedUntil and wake the readers blocked waiting for it
+static void channelObject_setSimulatedUntil(channelObject_t * co, uint64_t timestamp);
+/// Block while there is not enough space in the ringbuffer of the sink. Dropping packages is not an option
+/// deadlock is easily detectable if it causes one.
+static void channelObject_waitForSpace(channelObject_t * co, ringBuffer_t * buffer, uint32_t nBytes, uint64_t timestamp);
+/// Broadcast mode: free the space of broadcastBuffer that is already read by all enabled sinks.
+static void channelObject_releaseBroadcastRead(channelObject_t * co);
+/// Broadcast mode: make the events committed into broadcastBuffer visible to all enabled sinks.
+static void channelObject_publishBroadcast(channelObject_t * co);
+/// Write the header into the reserved space of the ringbuffer at offset: the timestamp and in variable length mode the size of the payload.
+static void channelObject_writeHeader(channelObject_t * co, ringBuffer_t * buffer, uint32_t offset, uint64_t timestamp, uint32_t size);
+/// Write the header and the payload of an event into the ringbuffer and publish them with a single commit.
+static void channelObject_writeEvent(channelObject_t * co, ringBuffer_t * buffer, uint64_t timestamp, const uint8_t * data, uint32_t size);
+/// Write an array of events into the ringbuffer. As many events are published with a single commit as fit into the free space of the ringbuffer.
+/// @param timestampStep 0: all events have the same timestamp, 1: event i has timestamp+i
+static void channelObject_writeEvents(channelObject_t * co, ringBuffer_t * buffer, uint64_t timestamp, uint32_t timestampStep, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes);
+/// Process events of the sink until the timestamp without waiting for the source.
+/// The callback gets a pointer into the ringbuffer - the event is copied into the read buffer of the sink only when it wraps around the end of the ringbuffer.
+static void channelObject_dispatchEventsUntil(channelObjectSink_t * sink, uint64_t timestamp);
+/// Process events of the sink until the timestamp with a single call of the batch callback and a single read from the ringbuffer.
+/// @param until simulatedUntil of the channel read before the ringbuffer - only the events until it are committed
+static void channelObject_dispatchBatchUntil(channelObjectSink_t * sink, uint64_t timestamp, uint64_t until);
+/// Drop the cancelled events at the read pointer of the sink (see CHANNEL_OBJECT_CANCELLED)
+static void channelObject_dropCancelled(channelObjectSink_t * sink);
+/// Copy nBytes from the spans of the batch starting at offset
+static void channelObject_batchCopy(const channelObjectBatch_t * batch, uint32_t offset, uint32_t nBytes, uint8_t * data);
+/// Optimistic mode: the readable part of the ringbuffer of the sink as the spans of a batch
+/// @return number of readable bytes
+static uint32_t channelObject_speculativeSpans(channelObjectSink_t * sink, channelObjectBatch_t * batch);
+/// Optimistic mode: read the header of the event at offset of the spans
+/// @return size of the payload of the event
+static uint32_t channelObject_speculativeHeader(channelObjectSink_t * sink, channelObjectBatch_t * batch, uint32_t offset, uint64_t * timestamp);
 
 
 void channelObject_create(channelObject_t * co, localClock_t * clock, uint32_t messageSize)
@@ -58,9 +110,54 @@ void channelObject_create(channelObject_t * co, localClock_t * clock, uint32_t m
   assert(clock!=NULL);
 	co->messageSize=messageSize;
 	co->nSink=0;
+	atomic_init(&(co->nEventsInserted), 0);
+	relativePtr_set(co->sinks, co->defaultSinks);
+	co->maxSink=MAX_CHANNEL_SINK;
 	co->simulatedUntil=clock->globalTime+1;
+	waitPolicy_initEvent(&(co->simulatedUntilEvent));
+	waitPolicy_initEvent(&(co->readEvent));
 	co->minimalLatency=1;
-	co->clock=clock;
+	relativePtr_set(co->clock, clock);
+	co->variableLength=false;
+	co->broadcast=false;
+	co->traceId=0;
+	co->writeBuffer=NULL;
+	co->pendingBuffer=NULL;
+	co->pendingData=NULL;
+}
+
+void channelObject_createBroadcast(channelObject_t * co, localClock_t * clock, uint32_t messageSize, uint32_t bufferSize, uint8_t * buffer)
+{
+  channelObject_create(co, clock, messageSize);
+  co->broadcast=true;
+  if((bufferSize&(bufferSize-1))==0)
+  {
+    ringBuffer_createPowerOfTwo(&(co->broadcastBuffer), bufferSize, buffer);
+  }else
+  {
+    ringBuffer_create(&(co->broadcastBuffer), bufferSize, buffer);
+  }
+}
+
+void channelObject_createBroadcastMirrored(channelObject_t * co, localClock_t * clock, uint32_t messageSize, uint32_t bufferSize, uint8_t * buffer)
+{
+  channelObject_create(co, clock, messageSize);
+  co->broadcast=true;
+  ringBuffer_createMirrored(&(co->broadcastBuffer), bufferSize, buffer);
+}
+
+void channelObject_setVariableLength(channelObject_t * co)
+{
+  assert(co->messageSize<=UINT16_MAX);
+  co->variableLength=true;
+}
+
+void channelObject_setSinkStorage(channelObject_t * co, uint32_t maxSink, channelObjectSink_t * storage)
+{
+  assert(co->nSink==0);
+  assert(storage!=NULL);
+  relativePtr_set(co->sinks, storage);
+  co->maxSink=maxSink;
 }
 
 void channelObject_setMinimalLatency(channelObject_t * co, uint64_t minimalLatency)
@@ -72,21 +169,77 @@ void channelObject_setMinimalLatency(channelObject_t * co, uint64_t minimalLaten
 channelObjectSink_t * channelObject_allocateSink(channelObject_t * co, uint32_t bufferSize, uint8_t * buffer)
 {
 	uint32_t index=co->nSink;
-	assert(index<MAX_CHANNEL_SINK);
-	channelObjectSink_t * sink=&(co->sinks[index]);
+	assert(!co->broadcast);
+	assert(index<co->maxSink);
+	channelObjectSink_t * sink=channelObject_getSink(co, index);
 	ringBuffer_create(&(sink->buffer), bufferSize, buffer);
-	sink->host=co;
+	relativePtr_set(sink->host, co);
+	sink->batchCallback=NULL;
+	sink->nextEventTimestamp=UINT64_MAX;
+	sink->speculativeOffset=0;
+	sink->speculativeReleased=0;
+	atomic_init(&(sink->cancelledFrom), UINT64_MAX);
 	co->nSink++;
 	return sink;
 }
+channelObjectSink_t * channelObject_allocateSinkMirrored(channelObject_t * co, uint32_t bufferSize, uint8_t * buffer)
+{
+  channelObjectSink_t * sink=channelObject_allocateSink(co, bufferSize, buffer);
+  ringBuffer_createMirrored(&(sink->buffer), bufferSize, buffer);
+  return sink;
+}
+channelObjectSink_t * channelObject_allocateBroadcastSink(channelObject_t * co)
+{
+  uint32_t index=co->nSink;
+  assert(co->broadcast);
+  assert(index<co->maxSink);
+  channelObjectSink_t * sink=channelObject_getSink(co, index);
+  ringBuffer_createView(&(sink->buffer), &(co->broadcastBuffer));
+  relativePtr_set(sink->host, co);
+  sink->batchCallback=NULL;
+  sink->nextEventTimestamp=UINT64_MAX;
+  sink->speculativeOffset=0;
+  sink->speculativeReleased=0;
+  atomic_init(&(sink->cancelledFrom), UINT64_MAX);
+  co->nSink++;
+  return sink;
+}
 void channelObject_waitSimulatedUntil(channelObject_t * co, uint64_t timestamp)
+{
+  channelObject_waitSimulatedUntilPolling(co, timestamp, NULL, NULL);
+}
+
+void channelObject_waitSimulatedUntilPolling(channelObject_t * co, uint64_t timestamp, channelObjectPollCallback_t poll, void * parameter)
 {
   if(co->simulatedUntil<timestamp)
   {
+    uint32_t iteration=0;
+    uint32_t nPolls=0;
     while(co->simulatedUntil<timestamp)
     {
-      localClock_checkExit(co->clock);
-      busyWaitIterate(co->simulatedUntil, timestamp, co->debugName);
+      if(poll!=NULL && (nPolls++&(CHANNEL_OBJECT_POLL_INTERVAL-1))==0)
+      {
+        poll(parameter);
+        if(co->simulatedUntil>=timestamp)
+        {
+          break;
+        }
+      }
+      busyWaitIterate(channelObject_getClock(co), co->simulatedUntil, timestamp, co->debugName);
+      if(waitPolicy_shouldBlock(&iteration))
+      {
+        uint32_t sequence=waitPolicy_prepareWait(&(co->simulatedUntilEvent));
+        if(co->simulatedUntil<timestamp)
+        {
+          waitPolicy_wait(&(co->simulatedUntilEvent), sequence);
+          busyWaitCheck(channelObject_getClock(co), co->simulatedUntil, timestamp, co->debugName);
+          // Woken up by the timeout or the source - poll again right away
+          nPolls=0;
+        }else
+        {
+          waitPolicy_cancelWait(&(co->simulatedUntilEvent));
+        }
+      }
     }
     busyWaitDone(co->simulatedUntil, timestamp);
   }
@@ -94,139 +247,858 @@ void channelObject_waitSimulatedUntil(channelObject_t * co, uint64_t timestamp)
 
 void channelObject_processEventsUntil(channelObjectSink_t * sink, uint64_t timestamp)
 {
-	channelObject_t * co=sink->host;
-	uint8_t * buffer=sink->readBuffer;
-	while(co->simulatedUntil<timestamp)
-	{
-	  localClock_checkExit(sink->host->clock);
-		busyWaitIterate(co->simulatedUntil, timestamp, co->debugName);
-	}
-  busyWaitDone(co->simulatedUntil, timestamp);
-  uint32_t availablebytes=ringBuffer_availableRead(&(sink->buffer));
-	while(availablebytes>=channelObject_datagramSize(co))
-	{
-		ringBuffer_peek(&(sink->buffer), 8, buffer);
-		uint64_t t=*((uint64_t *)buffer);
-		if(t>timestamp)
-		{
-			// All events processed until the timestamp
-			return;
-		}
-		ringBuffer_read(&(sink->buffer), channelObject_datagramSize(co), buffer);
-		uint64_t timestamp=*((uint64_t *) buffer);
-		channelObjectEventCallback_t eventCallback=sink->callback;
-		if(eventCallback!=NULL)
-		{
-			eventCallback(sink->parameter, timestamp, sink, buffer+8, co->messageSize);
-		}
-		availablebytes=ringBuffer_availableRead(&(sink->buffer));
-	}
+  channelObject_waitSimulatedUntil(channelObjectSink_getHost(sink), timestamp);
+  channelObject_dispatchEventsUntil(sink, timestamp);
 }
 uint64_t channelObjectSink_getNextEventTimeStamp(channelObjectSink_t * sink)
 {
-  uint32_t availablebytes=ringBuffer_availableRead(&(sink->buffer));
-  uint64_t ret=UINT64_MAX;
-  if(availablebytes>=CHANNEL_OBJECT_HEADER_SIZE)
+  uint64_t ret=sink->nextEventTimestamp;
+  if(ret==UINT64_MAX)
   {
-    ringBuffer_peek(&(sink->buffer), 8, (uint8_t *)&ret);
+    // Read before the ringbuffer: the events until simulatedUntil are in the ringbuffer and can not be cancelled any more
+    uint64_t until=channelObjectSink_getHost(sink)->simulatedUntil;
+    atomic_thread_fence(memory_order_acquire);
+    if(sink->speculativeOffset==0)
+    {
+      channelObject_dropCancelled(sink);
+    }
+    // Events are committed with their header at once so the timestamp at the read pointer always belongs to a complete event
+    if(ringBuffer_peek(&(sink->buffer), CHANNEL_OBJECT_HEADER_SIZE, (uint8_t *)&ret))
+    {
+      if((ret&CHANNEL_OBJECT_CANCELLED)==0 && ret<=until)
+      {
+        sink->nextEventTimestamp=ret;
+      }else
+      {
+        // Sent speculatively and may still be cancelled - no event is committed before simulatedUntil+1
+        ret=until+1;
+      }
+    }
   }
   return ret;
 }
+static void channelObject_dropCancelled(channelObjectSink_t * sink)
+{
+  channelObject_t * co=channelObjectSink_getHost(sink);
+  uint32_t headerSize=channelObject_headerSize(co);
+  uint8_t header[CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+  uint64_t t;
+  bool wasRead=false;
+  while(ringBuffer_peek(&(sink->buffer), headerSize, header))
+  {
+    memcpy(&t, header, CHANNEL_OBJECT_HEADER_SIZE);
+    if((t&CHANNEL_OBJECT_CANCELLED)==0)
+    {
+      break;
+    }
+    uint32_t size=co->messageSize;
+    if(co->variableLength)
+    {
+      uint16_t length;
+      memcpy(&length, header+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE);
+      size=length;
+    }
+    ringBuffer_read(&(sink->buffer), headerSize+size, NULL);
+    wasRead=true;
+  }
+  if(wasRead)
+  {
+    waitPolicy_notify(&(co->readEvent));
+  }
+}
 void channelObject_processEventsUntilNoWait(channelObjectSink_t * sink, uint64_t timestamp)
 {
-  channelObject_t * co=sink->host;
-  uint8_t * buffer=sink->readBuffer;
-/*  while(co->simulatedUntil<timestamp)
+  channelObject_dispatchEventsUntil(sink, timestamp);
+}
+static void channelObject_dispatchEventsUntil(channelObjectSink_t * sink, uint64_t timestamp)
+{
+  if(sink->nextEventTimestamp!=UINT64_MAX && sink->nextEventTimestamp>timestamp)
+  {
+    // The first event is known to be later - the ringbuffer is not accessed
+    return;
+  }
+  channelObject_t * co=channelObjectSink_getHost(sink);
+  // Only committed events are processed: an optimistic source sends events later than simulatedUntil speculatively and may cancel them.
+  // Read before the ringbuffer so that the events until it are all in the ringbuffer.
+  uint64_t until=co->simulatedUntil;
+  atomic_thread_fence(memory_order_acquire);
+  if(timestamp>until)
+  {
+    timestamp=until;
+  }
+  if(sink->batchCallback!=NULL)
   {
-    busyWaitIterate(co->simulatedUntil, timestamp);
+    channelObject_dispatchBatchUntil(sink, timestamp, until);
+    return;
   }
-  busyWaitDone(co->simulatedUntil, timestamp);
-  */
-  uint32_t availablebytes=ringBuffer_availableRead(&(sink->buffer));
-  while(availablebytes>=channelObject_datagramSize(co))
+  uint32_t headerSize=channelObject_headerSize(co);
+  uint32_t datagramSize=channelObject_datagramSize(co);
+  bool wasRead=false;
+  while(ringBuffer_canRead(&(sink->buffer), headerSize))
   {
-    ringBuffer_peek(&(sink->buffer), 8, buffer);
-    uint64_t t=*((uint64_t *)buffer);
+    uint8_t * event;
+    uint8_t header[CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+    uint64_t t;
+    uint32_t size=co->messageSize;
+    uint32_t n=ringBuffer_accessReadBuffer(&(sink->buffer), &event, datagramSize);
+    if(n<headerSize)
+    {
+      ringBuffer_peek(&(sink->buffer), headerSize, header);
+      event=header;
+    }
+    memcpy(&t, event, CHANNEL_OBJECT_HEADER_SIZE);
+    if(co->variableLength)
+    {
+      uint16_t length;
+      memcpy(&length, event+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE);
+      size=length;
+    }
+    if((t&CHANNEL_OBJECT_CANCELLED)!=0)
+    {
+      // Cancelled by the optimistic source - dropped without processing
+      ringBuffer_read(&(sink->buffer), headerSize+size, NULL);
+      wasRead=true;
+      continue;
+    }
     if(t>timestamp)
     {
-      // All events processed until the timestamp
-      return;
+      // All events processed until the timestamp. Speculative events are not cached - they may still be cancelled
+      if(t<=until)
+      {
+        sink->nextEventTimestamp=t;
+      }
+      break;
+    }
+    if(n<headerSize+size)
+    {
+      // The event wraps around the end of the ringbuffer - only this case needs a copy
+      event=channelObjectSink_readBuffer(sink);
+      ringBuffer_peek(&(sink->buffer), headerSize+size, event);
     }
-    ringBuffer_read(&(sink->buffer), channelObject_datagramSize(co), buffer);
-    uint64_t timestamp=*((uint64_t *) buffer);
     channelObjectEventCallback_t eventCallback=sink->callback;
     if(eventCallback!=NULL)
     {
-      eventCallback(sink->parameter, timestamp, sink, buffer+8, co->messageSize);
+      eventCallback(sink->parameter, t, sink, event+headerSize, size);
     }
-    availablebytes=ringBuffer_availableRead(&(sink->buffer));
+    // The event is released only after the callback returned because data may point into the ringbuffer
+    ringBuffer_read(&(sink->buffer), headerSize+size, NULL);
+    sink->nextEventTimestamp=UINT64_MAX;
+    wasRead=true;
+  }
+  if(wasRead)
+  {
+    // The writer may be blocked waiting for space in the ringbuffer
+    waitPolicy_notify(&(co->readEvent));
   }
 }
+static void channelObject_dispatchBatchUntil(channelObjectSink_t * sink, uint64_t timestamp, uint64_t until)
+{
+  channelObject_t * co=channelObjectSink_getHost(sink);
+  channelObjectBatch_t batch;
+  uint32_t available=ringBuffer_accessReadSpans(&(sink->buffer), &batch.span[0], &batch.spanBytes[0], &batch.span[1]);
+  uint32_t offset=0;
+  batch.spanBytes[1]=available-batch.spanBytes[0];
+  batch.nEvents=0;
+  batch.headerSize=channelObject_headerSize(co);
+  batch.messageSize=co->messageSize;
+  batch.variableLength=co->variableLength;
+  batch.offset=0;
+  uint64_t next=UINT64_MAX;
+  // Events are committed with their header at once so a complete header means a complete event
+  while(offset+batch.headerSize<=available)
+  {
+    uint8_t header[CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+    uint64_t t;
+    uint32_t size=batch.messageSize;
+    channelObject_batchCopy(&batch, offset, batch.headerSize, header);
+    memcpy(&t, header, CHANNEL_OBJECT_HEADER_SIZE);
+    if(batch.variableLength)
+    {
+      uint16_t length;
+      memcpy(&length, header+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE);
+      size=length;
+    }
+    if((t&CHANNEL_OBJECT_CANCELLED)!=0)
+    {
+      // Read together with the batch - skipped by channelObjectSink_nextBatchEvent()
+      offset+=batch.headerSize+size;
+      continue;
+    }
+    if(t>timestamp)
+    {
+      if(t<=until)
+      {
+        next=t;
+      }
+      break;
+    }
+    offset+=batch.headerSize+size;
+    batch.nEvents++;
+  }
+  sink->nextEventTimestamp=next;
+  if(batch.nEvents==0)
+  {
+    if(offset>0)
+    {
+      // Only cancelled events
+      ringBuffer_read(&(sink->buffer), offset, NULL);
+      waitPolicy_notify(&(co->readEvent));
+    }
+    return;
+  }
+  if(offset<=batch.spanBytes[0])
+  {
+    batch.spanBytes[0]=offset;
+    batch.spanBytes[1]=0;
+  }else
+  {
+    batch.spanBytes[1]=offset-batch.spanBytes[0];
+  }
+  channelObjectBatchCallback_t batchCallback=sink->batchCallback;
+  if(batchCallback!=NULL)
+  {
+    batchCallback(sink->parameter, sink, &batch);
+  }
+  ringBuffer_read(&(sink->buffer), offset, NULL);
+  waitPolicy_notify(&(co->readEvent));
+}
+static void channelObject_batchCopy(const channelObjectBatch_t * batch, uint32_t offset, uint32_t nBytes, uint8_t * data)
+{
+  if(offset>=batch->spanBytes[0])
+  {
+    memcpy(data, batch->span[1]+(offset-batch->spanBytes[0]), nBytes);
+  }else if(offset+nBytes<=batch->spanBytes[0])
+  {
+    memcpy(data, batch->span[0]+offset, nBytes);
+  }else
+  {
+    uint32_t firstSize=batch->spanBytes[0]-offset;
+    memcpy(data, batch->span[0]+offset, firstSize);
+    memcpy(data+firstSize, batch->span[1], nBytes-firstSize);
+  }
+}
+static uint32_t channelObject_speculativeSpans(channelObjectSink_t * sink, channelObjectBatch_t * batch)
+{
+  channelObject_t * co=channelObjectSink_getHost(sink);
+  uint32_t available=ringBuffer_accessReadSpans(&(sink->buffer), &batch->span[0], &batch->spanBytes[0], &batch->span[1]);
+  batch->spanBytes[1]=available-batch->spanBytes[0];
+  batch->nEvents=0;
+  batch->headerSize=channelObject_headerSize(co);
+  batch->messageSize=co->messageSize;
+  batch->variableLength=co->variableLength;
+  batch->offset=0;
+  return available;
+}
+static uint32_t channelObject_speculativeHeader(channelObjectSink_t * sink, channelObjectBatch_t * batch, uint32_t offset, uint64_t * timestamp)
+{
+  uint8_t header[CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+  channelObject_batchCopy(batch, offset, batch->headerSize, header);
+  memcpy(timestamp, header, CHANNEL_OBJECT_HEADER_SIZE);
+  if(batch->variableLength)
+  {
+    uint16_t length;
+    memcpy(&length, header+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE);
+    return length;
+  }
+  return batch->messageSize;
+}
+void channelObject_processEventsSpeculative(channelObjectSink_t * sink, uint64_t timestamp)
+{
+  channelObjectBatch_t batch;
+  uint32_t available=channelObject_speculativeSpans(sink, &batch);
+  uint32_t offset=sink->speculativeOffset;
+  // Events are committed with their header at once so a complete header means a complete event
+  while(offset+batch.headerSize<=available)
+  {
+    uint64_t t;
+    uint32_t size=channelObject_speculativeHeader(sink, &batch, offset, &t);
+    if((t&CHANNEL_OBJECT_CANCELLED)!=0)
+    {
+      offset+=batch.headerSize+size;
+      sink->speculativeOffset=offset;
+      continue;
+    }
+    if(t>timestamp)
+    {
+      break;
+    }
+    uint32_t dataOffset=offset+batch.headerSize;
+    uint8_t * data;
+    if(dataOffset>=batch.spanBytes[0])
+    {
+      data=batch.span[1]+(dataOffset-batch.spanBytes[0]);
+    }else if(dataOffset+size<=batch.spanBytes[0])
+    {
+      data=batch.span[0]+dataOffset;
+    }else
+    {
+      // The payload wraps around the end of the ringbuffer
+      data=channelObjectSink_readBuffer(sink);
+      channelObject_batchCopy(&batch, dataOffset, size, data);
+    }
+    channelObjectEventCallback_t eventCallback=sink->callback;
+    if(eventCallback!=NULL)
+    {
+      eventCallback(sink->parameter, t, sink, data, size);
+    }
+    offset=dataOffset+size;
+    sink->speculativeOffset=offset;
+  }
+}
+void channelObject_releaseSpeculative(channelObjectSink_t * sink, uint64_t position)
+{
+  assert(position>=sink->speculativeReleased && position<=channelObjectSink_getSpeculativePosition(sink));
+  uint32_t offset=(uint32_t)(position-sink->speculativeReleased);
+  if(offset>0)
+  {
+    ringBuffer_read(&(sink->buffer), offset, NULL);
+    sink->speculativeOffset-=offset;
+    sink->speculativeReleased+=offset;
+    sink->nextEventTimestamp=UINT64_MAX;
+    waitPolicy_notify(&(channelObjectSink_getHost(sink)->readEvent));
+  }
+}
+uint64_t channelObjectSink_getSpeculativePosition(channelObjectSink_t * sink)
+{
+  return sink->speculativeReleased+sink->speculativeOffset;
+}
+void channelObjectSink_setSpeculativePosition(channelObjectSink_t * sink, uint64_t position)
+{
+  assert(position>=sink->speculativeReleased);
+  sink->speculativeOffset=position-sink->speculativeReleased;
+}
+uint64_t channelObjectSink_getNextSpeculativeTimeStamp(channelObjectSink_t * sink)
+{
+  channelObjectBatch_t batch;
+  uint32_t available=channelObject_speculativeSpans(sink, &batch);
+  uint32_t offset=sink->speculativeOffset;
+  while(offset+batch.headerSize<=available)
+  {
+    uint64_t t;
+    offset+=batch.headerSize+channelObject_speculativeHeader(sink, &batch, offset, &t);
+    if((t&CHANNEL_OBJECT_CANCELLED)==0)
+    {
+      return t;
+    }
+  }
+  return UINT64_MAX;
+}
+uint64_t channelObjectSink_takeCancelled(channelObjectSink_t * sink)
+{
+  // Checked before the exchange so that the reader does not write the cache line of the writer at each step
+  if(atomic_load_explicit(&(sink->cancelledFrom), memory_order_relaxed)==UINT64_MAX)
+  {
+    return UINT64_MAX;
+  }
+  return atomic_exchange_explicit(&(sink->cancelledFrom), UINT64_MAX, memory_order_acquire);
+}
+void channelObjectSink_setBatchCallback(channelObjectSink_t * sink, channelObjectBatchCallback_t batchCallback)
+{
+  sink->batchCallback=batchCallback;
+}
+bool channelObjectSink_nextBatchEvent(channelObjectSink_t * sink, channelObjectBatch_t * batch, uint64_t * timestamp, uint8_t ** data, uint32_t * size)
+{
+  uint8_t header[CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+  uint32_t offset=batch->offset;
+  do
+  {
+    if(offset>=batch->spanBytes[0]+batch->spanBytes[1])
+    {
+      batch->offset=offset;
+      return false;
+    }
+    channelObject_batchCopy(batch, offset, batch->headerSize, header);
+    memcpy(timestamp, header, CHANNEL_OBJECT_HEADER_SIZE);
+    *size=batch->messageSize;
+    if(batch->variableLength)
+    {
+      uint16_t length;
+      memcpy(&length, header+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE);
+      *size=length;
+    }
+    offset+=batch->headerSize;
+    if((*timestamp&CHANNEL_OBJECT_CANCELLED)!=0)
+    {
+      // Cancelled events are read with the batch but not processed
+      offset+=*size;
+    }
+  } while((*timestamp&CHANNEL_OBJECT_CANCELLED)!=0);
+  if(offset>=batch->spanBytes[0])
+  {
+    *data=batch->span[1]+(offset-batch->spanBytes[0]);
+  }else if(offset+*size<=batch->spanBytes[0])
+  {
+    *data=batch->span[0]+offset;
+  }else
+  {
+    // The payload wraps around the end of the ringbuffer - only this case needs a copy
+    channelObject_batchCopy(batch, offset, *size, channelObjectSink_readBuffer(sink));
+    *data=channelObjectSink_readBuffer(sink);
+  }
+  batch->offset=offset+*size;
+  return true;
+}
 uint64_t channelObject_insertEvent(channelObject_t * co, uint64_t timestamp, uint8_t * data)
+{
+  return channelObject_insertEventSized(co, timestamp, data, co->messageSize);
+}
+
+uint64_t channelObject_insertEventSized(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size)
 {
 	assert(co!=NULL);
+	assert(size==co->messageSize || (co->variableLength && size<co->messageSize));
+	if(channelObject_isSpeculative(co))
+	{
+	  return timeWarp_bufferEvent(channelObject_getClock(co)->timeWarp, co, timestamp, data, size);
+	}
 	if(timestamp<=co->simulatedUntil)
 	{
 		// TODO should it be an assert? It is not allowed to add an event to the current end of simulation timestamp
 		timestamp=co->simulatedUntil+1;
 	}
-	for(uint32_t i=0;i<co->nSink;++i)
+	if(co->broadcast)
 	{
-		channelObjectSink_t * sink=&(co->sinks[i]);
-		if(sink->enabled)
-		{
-			/// Block while there is space in the ringbuffer. Dropping packages is not an option
-			/// deadlock is easily detectable if it causes one.
-		  if(ringBuffer_availableWrite(&(sink->buffer))< channelObject_datagramSize(co))
-		  {
-        while(ringBuffer_availableWrite(&(sink->buffer))< channelObject_datagramSize(co))
-        {
-          localClock_checkExit(sink->host->clock);
-          busyWaitIterate(timestamp, timestamp, "write ringbuffer");
-        }
-        busyWaitDone(timestamp, timestamp);
-		  }
-			ringBuffer_write(&(sink->buffer), 8, (uint8_t *)&timestamp);
-			ringBuffer_write(&(sink->buffer), co->messageSize, data);
-		}
+	  channelObject_waitForSpace(co, &(co->broadcastBuffer), channelObject_headerSize(co)+size, timestamp);
+	  channelObject_writeEvent(co, &(co->broadcastBuffer), timestamp, data, size);
+	  channelObject_publishBroadcast(co);
+	}else
+	{
+    for(uint32_t i=0;i<co->nSink;++i)
+    {
+      channelObjectSink_t * sink=channelObject_getSink(co, i);
+      if(sink->enabled)
+      {
+        channelObject_waitForSpace(co, &(sink->buffer), channelObject_headerSize(co)+size, timestamp);
+        channelObject_writeEvent(co, &(sink->buffer), timestamp, data, size);
+      }
+    }
 	}
-	co->simulatedUntil=timestamp;
+	channelObject_trace(co, timestamp, data, size);
+	atomic_fetch_add_explicit(&(co->nEventsInserted), 1, memory_order_release);
+	channelObject_setSimulatedUntil(co, timestamp);
 	return timestamp;
 }
 
+uint64_t channelObject_insertEvents(channelObject_t * co, uint64_t timestamp, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes, bool sameTimestamp)
+{
+  assert(co!=NULL);
+  assert(nEvents>0);
+  uint64_t batchSize=0;
+  for(uint32_t i=0;i<nEvents;++i)
+  {
+    assert(sizes==NULL || sizes[i]==co->messageSize || (co->variableLength && sizes[i]<co->messageSize));
+    batchSize+=channelObject_headerSize(co)+(sizes==NULL?co->messageSize:sizes[i]);
+  }
+  uint32_t timestampStep=sameTimestamp?0:1;
+  if(channelObject_isSpeculative(co))
+  {
+    return timeWarp_bufferEvents(channelObject_getClock(co)->timeWarp, co, timestamp, nEvents, data, sizes, sameTimestamp);
+  }
+  if(timestamp<=co->simulatedUntil)
+  {
+    timestamp=co->simulatedUntil+1;
+  }
+  // A batch split into chunks is only readable after the last chunk so it can not wait for space freed by reading its first chunks
+  if(co->broadcast)
+  {
+    assertMsg(batchSize<=ringBuffer_getCapacity(&(co->broadcastBuffer)), "Batch of %u events does not fit into the ringbuffer of channel %s", nEvents, co->debugName);
+  }else
+  {
+    for(uint32_t i=0;i<co->nSink;++i)
+    {
+      channelObjectSink_t * sink=channelObject_getSink(co, i);
+      assertMsg(!sink->enabled || batchSize<=ringBuffer_getCapacity(&(sink->buffer)), "Batch of %u events does not fit into the ringbuffer of channel %s", nEvents, co->debugName);
+    }
+  }
+  if(co->broadcast)
+  {
+    channelObject_writeEvents(co, &(co->broadcastBuffer), timestamp, timestampStep, nEvents, data, sizes);
+  }else
+  {
+    for(uint32_t i=0;i<co->nSink;++i)
+    {
+      channelObjectSink_t * sink=channelObject_getSink(co, i);
+      if(sink->enabled)
+      {
+        channelObject_writeEvents(co, &(sink->buffer), timestamp, timestampStep, nEvents, data, sizes);
+      }
+    }
+  }
+  for(uint32_t i=0;i<nEvents;++i)
+  {
+    channelObject_trace(co, timestamp+i*timestampStep, data[i], sizes==NULL?co->messageSize:sizes[i]);
+  }
+  // Readers only process the events until simulatedUntil so a batch split into multiple commits is still visible at once
+  timestamp+=((uint64_t)(nEvents-1))*timestampStep;
+  atomic_fetch_add_explicit(&(co->nEventsInserted), nEvents, memory_order_release);
+  channelObject_setSimulatedUntil(co, timestamp);
+  return timestamp;
+}
+
+void channelObject_setWriteBuffer(channelObject_t * co, uint32_t bufferSize, uint8_t * buffer)
+{
+  assert(bufferSize>=co->messageSize);
+  assert(buffer!=NULL);
+  co->writeBuffer=buffer;
+}
+
+uint8_t * channelObject_reserveEvent(channelObject_t * co, uint64_t timestamp)
+{
+  assert(co!=NULL);
+  // Not supported in optimistic mode - the event could not be cancelled or buffered until it is committed
+  assert(channelObject_getClock(co)->timeWarp==NULL);
+  if(timestamp<=co->simulatedUntil)
+  {
+    timestamp=co->simulatedUntil+1;
+  }
+  co->pendingTimestamp=timestamp;
+  co->pendingData=co->writeBuffer;
+  co->pendingBuffer=NULL;
+  ringBuffer_t * buffer=NULL;
+  if(co->broadcast)
+  {
+    buffer=&(co->broadcastBuffer);
+  }else
+  {
+    for(uint32_t i=0;i<co->nSink;++i)
+    {
+      if(channelObject_getSink(co, i)->enabled)
+      {
+        // Only the first enabled sink can hold the event in place
+        buffer=&(channelObject_getSink(co, i)->buffer);
+        break;
+      }
+    }
+  }
+  if(buffer!=NULL)
+  {
+    uint8_t * ptr;
+    channelObject_waitForSpace(co, buffer, channelObject_datagramSize(co), timestamp);
+    if(ringBuffer_reserve(buffer, channelObject_datagramSize(co), &ptr)==channelObject_datagramSize(co))
+    {
+      co->pendingData=ptr+channelObject_headerSize(co);
+      co->pendingBuffer=buffer;
+    }
+  }
+  assertMsg(co->pendingData!=NULL, "Write buffer of channel %s is not set", co->debugName);
+  return co->pendingData;
+}
+
+uint64_t channelObject_commitEvent(channelObject_t * co)
+{
+  return channelObject_commitEventSized(co, co->messageSize);
+}
+
+uint64_t channelObject_commitEventSized(channelObject_t * co, uint32_t size)
+{
+  uint64_t timestamp=co->pendingTimestamp;
+  assert(size==co->messageSize || (co->variableLength && size<co->messageSize));
+  // Traced before the commit - the payload may be consumed by the reader once it is committed in place
+  channelObject_trace(co, timestamp, co->pendingData, size);
+  if(co->broadcast)
+  {
+    if(co->pendingBuffer==NULL)
+    {
+      channelObject_waitForSpace(co, &(co->broadcastBuffer), channelObject_headerSize(co)+size, timestamp);
+      channelObject_writeEvent(co, &(co->broadcastBuffer), timestamp, co->pendingData, size);
+    }
+  }else
+  {
+    for(uint32_t i=0;i<co->nSink;++i)
+    {
+      channelObjectSink_t * sink=channelObject_getSink(co, i);
+      if(sink->enabled && &(sink->buffer)!=co->pendingBuffer)
+      {
+        channelObject_waitForSpace(co, &(sink->buffer), channelObject_headerSize(co)+size, timestamp);
+        channelObject_writeEvent(co, &(sink->buffer), timestamp, co->pendingData, size);
+      }
+    }
+  }
+  if(co->pendingBuffer!=NULL)
+  {
+    // Payload is already in place - this ringbuffer is committed last because the other sinks copy the payload from it
+    channelObject_writeHeader(co, co->pendingBuffer, 0, timestamp, size);
+    ringBuffer_commit(co->pendingBuffer, channelObject_headerSize(co)+size);
+    co->pendingBuffer=NULL;
+  }
+  if(co->broadcast)
+  {
+    channelObject_publishBroadcast(co);
+  }
+  co->pendingData=NULL;
+  atomic_fetch_add_explicit(&(co->nEventsInserted), 1, memory_order_release);
+  channelObject_setSimulatedUntil(co, timestamp);
+  return timestamp;
+}
+
+bool channelObject_canSendSpeculative(channelObject_t * co, uint32_t nEvents, uint32_t payloadBytes)
+{
+  uint32_t nBytes=nEvents*channelObject_headerSize(co)+payloadBytes;
+  if(co->broadcast)
+  {
+    if(!ringBuffer_canWrite(&(co->broadcastBuffer), nBytes))
+    {
+      channelObject_releaseBroadcastRead(co);
+    }
+    return ringBuffer_canWrite(&(co->broadcastBuffer), nBytes);
+  }
+  for(uint32_t i=0;i<co->nSink;++i)
+  {
+    channelObjectSink_t * sink=channelObject_getSink(co, i);
+    if(sink->enabled && !ringBuffer_canWrite(&(sink->buffer), nBytes))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void channelObject_sendSpeculative(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size, uint64_t * positions)
+{
+  uint32_t nBytes=channelObject_headerSize(co)+size;
+  if(co->broadcast)
+  {
+    assert(ringBuffer_canWrite(&(co->broadcastBuffer), nBytes));
+    positions[0]=ringBuffer_getWritePosition(&(co->broadcastBuffer));
+    channelObject_writeEvent(co, &(co->broadcastBuffer), timestamp, data, size);
+    channelObject_publishBroadcast(co);
+    return;
+  }
+  for(uint32_t i=0;i<co->nSink;++i)
+  {
+    channelObjectSink_t * sink=channelObject_getSink(co, i);
+    positions[i]=UINT64_MAX;
+    if(sink->enabled)
+    {
+      assert(ringBuffer_canWrite(&(sink->buffer), nBytes));
+      positions[i]=ringBuffer_getWritePosition(&(sink->buffer));
+      channelObject_writeEvent(co, &(sink->buffer), timestamp, data, size);
+    }
+  }
+}
+
+void channelObject_cancelSpeculative(channelObject_t * co, uint64_t timestamp, uint32_t nPositions, const uint64_t * positions)
+{
+  // Only the flag bit changes so a reader reading the header at the same time sees either the event or its cancellation.
+  // The event is not committed so it is still in the ringbuffer: the readers do not consume it before simulatedUntil reaches it.
+  uint64_t cancelled=timestamp|CHANNEL_OBJECT_CANCELLED;
+  if(co->broadcast)
+  {
+    ringBuffer_overwrite(&(co->broadcastBuffer), (uint32_t)positions[0], 0, CHANNEL_OBJECT_HEADER_SIZE, (uint8_t *)&cancelled);
+  }
+  for(uint32_t i=0;i<co->nSink;++i)
+  {
+    channelObjectSink_t * sink=channelObject_getSink(co, i);
+    if(co->broadcast?!sink->enabled:(i>=nPositions || positions[i]==UINT64_MAX))
+    {
+      continue;
+    }
+    if(!co->broadcast)
+    {
+      ringBuffer_overwrite(&(sink->buffer), (uint32_t)positions[i], 0, CHANNEL_OBJECT_HEADER_SIZE, (uint8_t *)&cancelled);
+    }
+    // Released after the flag: the reader rolling back on the notice processes the event again and finds it cancelled
+    uint64_t from=atomic_load_explicit(&(sink->cancelledFrom), memory_order_relaxed);
+    while(timestamp<from && !atomic_compare_exchange_weak_explicit(&(sink->cancelledFrom), &from, timestamp, memory_order_release, memory_order_relaxed))
+    {
+    }
+  }
+}
+
+void channelObject_commitSpeculative(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size)
+{
+  // Equal for the following events of a same timestamp group
+  assert(timestamp>=co->simulatedUntil);
+  channelObject_trace(co, timestamp, data, size);
+  atomic_fetch_add_explicit(&(co->nEventsInserted), 1, memory_order_release);
+  channelObject_setSimulatedUntil(co, timestamp);
+}
+
+static void channelObject_waitForSpace(channelObject_t * co, ringBuffer_t * buffer, uint32_t nBytes, uint64_t timestamp)
+{
+  if(!ringBuffer_canWrite(buffer, nBytes))
+  {
+    uint32_t iteration=0;
+    if(co->broadcast)
+    {
+      channelObject_releaseBroadcastRead(co);
+    }
+    while(!ringBuffer_canWrite(buffer, nBytes))
+    {
+      busyWaitIterate(channelObject_getClock(co), timestamp, timestamp, "write ringbuffer");
+      if(waitPolicy_shouldBlock(&iteration))
+      {
+        uint32_t sequence=waitPolicy_prepareWait(&(co->readEvent));
+        if(co->broadcast)
+        {
+          channelObject_releaseBroadcastRead(co);
+        }
+        if(!ringBuffer_canWrite(buffer, nBytes))
+        {
+          waitPolicy_wait(&(co->readEvent), sequence);
+          busyWaitCheck(channelObject_getClock(co), timestamp, timestamp, "write ringbuffer");
+        }else
+        {
+          waitPolicy_cancelWait(&(co->readEvent));
+        }
+      }
+      if(co->broadcast)
+      {
+        channelObject_releaseBroadcastRead(co);
+      }
+    }
+    busyWaitDone(timestamp, timestamp);
+  }
+}
+
+static void channelObject_releaseBroadcastRead(channelObject_t * co)
+{
+  uint32_t unread=0;
+  for(uint32_t i=0;i<co->nSink;++i)
+  {
+    channelObjectSink_t * sink=channelObject_getSink(co, i);
+    if(sink->enabled)
+    {
+      uint32_t n=ringBuffer_viewUnread(&(co->broadcastBuffer), &(sink->buffer));
+      if(n>unread)
+      {
+        unread=n;
+      }
+    }
+  }
+  ringBuffer_releaseRead(&(co->broadcastBuffer), unread);
+}
+
+static void channelObject_publishBroadcast(channelObject_t * co)
+{
+  for(uint32_t i=0;i<co->nSink;++i)
+  {
+    channelObjectSink_t * sink=channelObject_getSink(co, i);
+    if(sink->enabled)
+    {
+      ringBuffer_publishView(&(co->broadcastBuffer), &(sink->buffer));
+    }
+  }
+}
+
+static void channelObject_writeHeader(channelObject_t * co, ringBuffer_t * buffer, uint32_t offset, uint64_t timestamp, uint32_t size)
+{
+  ringBuffer_writeReserved(buffer, offset, CHANNEL_OBJECT_HEADER_SIZE, (uint8_t *)&timestamp);
+  if(co->variableLength)
+  {
+    uint16_t length=size;
+    ringBuffer_writeReserved(buffer, offset+CHANNEL_OBJECT_HEADER_SIZE, CHANNEL_OBJECT_LENGTH_SIZE, (uint8_t *)&length);
+  }
+}
+
+static void channelObject_writeEvent(channelObject_t * co, ringBuffer_t * buffer, uint64_t timestamp, const uint8_t * data, uint32_t size)
+{
+  uint32_t headerSize=channelObject_headerSize(co);
+  channelObject_writeHeader(co, buffer, 0, timestamp, size);
+  ringBuffer_writeReserved(buffer, headerSize, size, data);
+  ringBuffer_commit(buffer, headerSize+size);
+}
+
+static void channelObject_writeEvents(channelObject_t * co, ringBuffer_t * buffer, uint64_t timestamp, uint32_t timestampStep, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes)
+{
+  uint32_t headerSize=channelObject_headerSize(co);
+  uint32_t i=0;
+  while(i<nEvents)
+  {
+    uint32_t size=sizes==NULL?co->messageSize:sizes[i];
+    uint32_t offset=0;
+    channelObject_waitForSpace(co, buffer, headerSize+size, timestamp+((uint64_t)i)*timestampStep);
+    do
+    {
+      channelObject_writeHeader(co, buffer, offset, timestamp+((uint64_t)i)*timestampStep, size);
+      ringBuffer_writeReserved(buffer, offset+headerSize, size, data[i]);
+      offset+=headerSize+size;
+      ++i;
+      if(i<nEvents)
+      {
+        size=sizes==NULL?co->messageSize:sizes[i];
+      }
+    } while(i<nEvents && ringBuffer_canWrite(buffer, offset+headerSize+size));
+    ringBuffer_commit(buffer, offset);
+    if(co->broadcast)
+    {
+      channelObject_publishBroadcast(co);
+    }
+  }
+}
+
+static void channelObject_setSimulatedUntil(channelObject_t * co, uint64_t timestamp)
+{
+  co->simulatedUntil=timestamp;
+  waitPolicy_notify(&(co->simulatedUntilEvent));
+}
+
 void channelObject_updateTime(channelObject_t * co, uint64_t timestamp)
 {
-  uint64_t t=timestamp+co->minimalLatency;
+  // Saturated - lookahead may mark the channel simulated until the end of time
+  uint64_t t=timestamp>UINT64_MAX-co->minimalLatency?UINT64_MAX:timestamp+co->minimalLatency;
 	if(t<co->simulatedUntil)
 	{
 	}else
 	{
-	  co->simulatedUntil=t;
+	  channelObject_setSimulatedUntil(co, t);
 	}
 }
 
+void channelObject_promiseNoEventBefore(channelObject_t * co, uint64_t timestamp)
+{
+  if(timestamp>0 && timestamp-1>co->simulatedUntil)
+  {
+    channelObject_setSimulatedUntil(co, timestamp-1);
+  }
+}
+
+bool channelObjectSink_bindToNode(channelObjectSink_t * sink, int node)
+{
+  assert(!channelObjectSink_getHost(sink)->broadcast);
+  return sharedMemory_bindToNode(ringBuffer_getBuffer(&(sink->buffer)), sink->buffer.bufferSize, node);
+}
+
 void channelObjectSink_setEnabled(channelObjectSink_t * sink, bool enabled, channelObjectEventCallback_t callback, void * parameter, uint32_t bufferSize, uint8_t * buffer)
 {
 	sink->parameter=parameter;
 	sink->callback=callback;
+	if(enabled && !sink->enabled && channelObjectSink_getHost(sink)->broadcast)
+	{
+	  // Start reading at the current write position - events written while disabled may already be overwritten
+	  ringBuffer_createView(&(sink->buffer), &(channelObjectSink_getHost(sink)->broadcastBuffer));
+	  sink->nextEventTimestamp=UINT64_MAX;
+	  atomic_thread_fence(memory_order_release);
+	}
 	sink->enabled=enabled;
-	if(sink->callback!=NULL)
+	if(sink->callback!=NULL || sink->batchCallback!=NULL)
 	{
-	  assert(bufferSize>=sink->host->messageSize+CHANNEL_OBJECT_HEADER_SIZE);
+	  assert(bufferSize>=channelObject_datagramSize(channelObjectSink_getHost(sink)));
 	  assert(buffer!=NULL);
-	  sink->readBuffer=buffer;
+	  relativePtr_set(sink->readBuffer, buffer);
 	}
 }
 
 static uint64_t current_millis() {
-    struct timeval te;
-    gettimeofday(&te, NULL); // get current time
-    uint64_t milliseconds = te.tv_sec*1000LL + te.tv_usec/1000; // calculate milliseconds
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &t);
+    uint64_t milliseconds = t.tv_sec*1000LL + t.tv_nsec/1000000; // calculate milliseconds
     return milliseconds;
 }
 
-static void busyWaitIterate(uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName)
+static inline void busyWaitIterate(localClock_t * clock, uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName)
+{
+  waitPolicy_cpuRelax();
+  spinCount++;
+  if((spinCount&(BUSY_WAIT_CHECK_INTERVAL-1))==0)
+  {
+    busyWaitCheck(clock, availableTimestamp, targetTimestamp, debugName);
+  }
+}
+
+static void busyWaitCheck(localClock_t * clock, uint64_t availableTimestamp, uint64_t targetTimestamp, const char * debugName)
 {
+  localClock_checkExit(clock);
   if(wasLogged)
   {
     // In case we already waited 10 milliseconds then we guess the other processes are stopped by debugging.
@@ -236,7 +1108,7 @@ static void busyWaitIterate(uint64_t availableTimestamp, uint64_t targetTimestam
     t.tv_nsec = 1000000u;
     nanosleep(&t, NULL);
   }
-  if(currentTarget!=targetTimestamp)
+  if(startWaitAtMillis==0 || currentTarget!=targetTimestamp)
   {
     currentTarget=targetTimestamp;
     startWaitAtMillis=current_millis();
@@ -253,6 +1125,8 @@ static void busyWaitIterate(uint64_t availableTimestamp, uint64_t targetTimestam
 }
 static void busyWaitDone(uint64_t availableTimestamp, uint64_t targetTimestamp)
 {
+  spinCount=0;
+  startWaitAtMillis=0;
   if(wasLogged)
   {
     wasLogged=false;
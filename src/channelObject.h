@@ -25,11 +25,19 @@ SOFTWARE.
 #define SIMULATOR_CHANNEL_OBJECT_H
 #include "ringBuffer.h"
 #include "localClock.h"
+#include "waitPolicy.h"
 
 /// Maximum number of sinks of a single channel. If needs to be increased it only has RAM usage effect.
 #define MAX_CHANNEL_SINK 4
 /// When events are put into a causal effect channel then this is the size of the additional header that is put into the ringbuffer.
 #define CHANNEL_OBJECT_HEADER_SIZE 8
+/// Size of the length field that follows the timestamp in the header of the events of variable length channels (see channelObject_setVariableLength())
+#define CHANNEL_OBJECT_LENGTH_SIZE 2
+/// Size of the event header of variable length channels
+#define CHANNEL_OBJECT_VARIABLE_HEADER_SIZE (CHANNEL_OBJECT_HEADER_SIZE+CHANNEL_OBJECT_LENGTH_SIZE)
+/// Flag set in the timestamp of the header of an event that was sent speculatively by an optimistic source and cancelled by its rollback (anti-message, see timeWarp.h).
+/// Readers skip such events. Cancelled events are always later than simulatedUntil of the channel so they are never processed by a conservative reader.
+#define CHANNEL_OBJECT_CANCELLED (1ull<<63)
 /// Name of channel bytes limit
 #define MAX_CHANNEL_NAME_LENGTH 255
 
@@ -40,33 +48,79 @@ struct channelObjectSink_str;
 /// @param parameter user provided parameter pointer - which was set by channelObjectSink_setEnabled(...) call
 /// @param globalTimestamp the time stamp of the event on the global clock when it has to be processed on the receiver side
 /// @param co pointer to the channel sink that this event was read from
-/// @param data data of the event. Type or structure is defined by the implementor of the channel
-/// @param size size of data in bytes.
+/// @param data data of the event. Type or structure is defined by the implementor of the channel.
+///   Points into the ringbuffer of the sink (or into the read buffer when the event wraps around) and is only valid until the callback returns. Not aligned.
+/// @param size size of data in bytes. The actual size of the event in variable length mode (see channelObject_setVariableLength())
 typedef void (*channelObjectEventCallback_t) (void * parameter, uint64_t globalTimestamp, struct channelObjectSink_str * co, uint8_t * data, uint32_t size);
 
+/// Events passed to a batch callback at once. The events are stored with their headers in the ringbuffer of the sink in one or two continuous spans
+/// (two when the events wrap around the end of the ringbuffer). Use channelObjectSink_nextBatchEvent() to iterate the events - it skips the cancelled events
+/// of an optimistic source (see CHANNEL_OBJECT_CANCELLED) that are read together with the batch.
+typedef struct
+{
+  /// The spans of the events in the ringbuffer. The second span continues the first one.
+  uint8_t * span[2];
+  /// Size of the spans in bytes. The second span is empty when the events do not wrap around the end of the ringbuffer.
+  uint32_t spanBytes[2];
+  /// Number of events in the batch
+  uint32_t nEvents;
+  /// Size of the header of each event: CHANNEL_OBJECT_HEADER_SIZE or CHANNEL_OBJECT_VARIABLE_HEADER_SIZE in variable length mode
+  uint32_t headerSize;
+  /// Size of the events in fixed size mode
+  uint32_t messageSize;
+  /// Variable length mode: the size of each event is stored in its header
+  bool variableLength;
+  /// Iterator state of channelObjectSink_nextBatchEvent(): offset of the next event within the spans
+  uint32_t offset;
+} channelObjectBatch_t;
+
+/// Callback type that handles all events of a sink that are processed by a single channelObject_processEventsUntil() call at once.
+/// The events are removed from the ringbuffer with a single read after the callback returns.
+/// @param parameter user provided parameter pointer - which was set by channelObjectSink_setEnabled(...) call
+/// @param co pointer to the channel sink that the events were read from
+/// @param batch the events - only valid until the callback returns. Contains at least one event.
+typedef void (*channelObjectBatchCallback_t) (void * parameter, struct channelObjectSink_str * co, channelObjectBatch_t * batch);
+
 /// The channel sink object. Each receiver of the channel has one sink object that holds a ringbuffer with the channel events.
-/// (Receivers need a separate sink object because the ringBuffer structure can only have one reader not more. It could be possible to implement the same behaviour with a single multi-reader ringbuffer. That could spare some RAM.
+/// (Receivers need a separate sink object because the ringBuffer structure can only have one reader not more.)
+/// In broadcast mode (channelObject_createBroadcast()) the ringbuffer of the sink is a reader view of the single ringbuffer of the channel:
+/// each event is written only once and each sink has its own read pointer.
 typedef struct channelObjectSink_str
 {
 	/// This stores event timestamps and event data pairs
 	ringBuffer_t buffer;
-	/// The channel that is the source of this sink
-	struct channelObject_str * host;
+	/// The channel that is the source of this sink - relative pointer (see channelObjectSink_getHost())
+	relativePtr_t host;
 	/// Enabled for write. When reading is not running then must be disabled to avoid blocking the write thread.
 	volatile bool enabled;
 	/// This callback is called when an event is processed from the channel sink.
 	volatile channelObjectEventCallback_t callback;
+	/// When set then this callback is called with all events processed at once instead of calling callback for each event.
+	volatile channelObjectBatchCallback_t batchCallback;
 	/// User defined parameter that is passed to the callback. Not handled by the library.
 	void * parameter;
-	/// Temporary buffer used to store the events read from the sink. The creator of the object allocates this buffer statically
-	uint8_t * readBuffer;
+	/// Temporary buffer used to store the events read from the sink when the event wraps around the end of the ringbuffer. The creator of the object allocates this buffer statically
+	/// Relative pointer: the buffer may be in the shared memory region or in the memory of the reader process
+	relativePtr_t readBuffer;
+	/// Optimistic source: earliest timestamp of the events cancelled since the reader last checked (see channelObjectSink_takeCancelled()). UINT64_MAX when there is none.
+	/// An optimistic reader that processed a cancelled event speculatively rolls back to its timestamp.
+	_Atomic uint64_t cancelledFrom;
+	/// Reader side state - written by the reader on each consume, so it is on its own cache line and the writer reading the fields above is not disturbed.
+	/// Cache of the timestamp of the event at the read pointer. UINT64_MAX when not known: the ringbuffer was empty when checked or the event was consumed.
+	/// The event at the read pointer only changes when the reader consumes it so the cached value stays valid until then without reading the ringbuffer.
+	_Alignas(SIMULATOR_CACHE_LINE_SIZE) uint64_t nextEventTimestamp;
+	/// Optimistic mode (see localClock_setOptimistic()): number of bytes after the read pointer that are processed speculatively but kept in the ringbuffer for a rollback
+	uint32_t speculativeOffset;
+	/// Optimistic mode: number of bytes released from the ringbuffer since the sink was allocated. speculativeReleased+speculativeOffset is the position of the next event to process.
+	uint64_t speculativeReleased;
 } channelObjectSink_t;
 
 /// The channel object. The event source writes the events into this object.
 typedef struct channelObject_str
 {
-  // The clock that owns this channel
-  localClock_t * clock;
+  // The clock that owns this channel - relative pointer (see channelObject_getClock()). Readers only access its exit flag
+  // so it is placed into the shared memory region when the processes of the simulation must exit together.
+  relativePtr_t clock;
 	/// The simulation of this channel is ready until this timestamp. Readers of the channel
 	/// can advance their simulation until this timestamp without waiting.
 	volatile uint64_t simulatedUntil;
@@ -76,19 +130,78 @@ typedef struct channelObject_str
 	uint64_t minimalLatency;
 	/// Set a name of the channel - Useful because it is visible in debugger or can be written into log files.
 	char debugName[MAX_CHANNEL_NAME_LENGTH+1];
-	/// Size of the messages in this channel. Current implementation only allows same size messages within a channel.
+	/// Size of the messages in this channel. In variable length mode this is the maximum size of the messages.
 	uint32_t messageSize;
+	/// Variable length mode: each event stores its own size in the header so events only take the space of their actual size.
+	bool variableLength;
 	/// Number of event sinks registered
 	uint32_t nSink;
+	/// Broadcast mode: events are written once into broadcastBuffer and the sinks read it through views.
+	bool broadcast;
+	/// The single ringbuffer of the channel in broadcast mode. Its read pointer is the read pointer of the slowest enabled sink.
+	ringBuffer_t broadcastBuffer;
+	/// Writer side temporary buffer used by channelObject_reserveEvent() when the event can not be filled in place. Set by channelObject_setWriteBuffer()
+	uint8_t * writeBuffer;
+	/// State of the event between channelObject_reserveEvent() and channelObject_commitEvent()
+	uint64_t pendingTimestamp;
+	/// Payload of the pending event: points into pendingBuffer or to writeBuffer
+	uint8_t * pendingData;
+	/// The ringbuffer that holds the pending event in place. NULL means the event is filled in writeBuffer
+	ringBuffer_t * pendingBuffer;
+	/// Notified when simulatedUntil is increased - readers block on it when the wait policy decides to block (see waitPolicy.h)
+	waitPolicy_event_t simulatedUntilEvent;
+	/// Notified when a sink read events from its ringbuffer - the writer blocks on it while there is no space in the ringbuffer
+	waitPolicy_event_t readEvent;
+	/// ID of the channel in the trace of the source clock. 0 means the channel is not traced (see tracer.h)
+	uint16_t traceId;
+	/// Number of events inserted into the channel. Incremented after the events are visible in the ringbuffers of the sinks (see timeCoordinator.h)
+	_Atomic uint64_t nEventsInserted;
 	/// Storage for sinks registered with this channel. Unregistered sinks are unconfigured.
-	channelObjectSink_t sinks[MAX_CHANNEL_SINK];
+	/// Points to defaultSinks unless larger storage is set by channelObject_setSinkStorage()
+	/// Relative pointer - see channelObject_getSink()
+	relativePtr_t sinks;
+	/// Number of sinks that fit into the storage
+	uint32_t maxSink;
+	/// Default storage of the sinks
+	channelObjectSink_t defaultSinks[MAX_CHANNEL_SINK];
 } channelObject_t;
 
+/// The clock that owns the channel
+static inline localClock_t * channelObject_getClock(channelObject_t * co)
+{
+  return relativePtr_get(co->clock, localClock_t);
+}
+/// The sink of the channel with the given index
+static inline channelObjectSink_t * channelObject_getSink(channelObject_t * co, uint32_t index)
+{
+  return relativePtr_get(co->sinks, channelObjectSink_t)+index;
+}
+/// The channel that is the source of the sink
+static inline channelObject_t * channelObjectSink_getHost(channelObjectSink_t * sink)
+{
+  return relativePtr_get(sink->host, channelObject_t);
+}
 
 /// Initialize the channel structure
 /// @param channel uninitialized static storage channel structure
 /// @param messageSize size of a single message in bytes. A 64 bit timestamp is also stored with each message.
 void channelObject_create(channelObject_t * channel, localClock_t * clock, uint32_t messageSize);
+/// Initialize the channel structure in broadcast mode: events are written once into a single ringbuffer that is read by all sinks.
+/// The writer is limited by the slowest enabled sink. Sinks must be allocated using channelObject_allocateBroadcastSink().
+/// @param bufferSize size of the buffer in bytes. Power of two sizes use the power of two ringbuffer (see ringBuffer_createPowerOfTwo())
+/// @param buffer buffer used as ringbuffer to store events of all sinks
+void channelObject_createBroadcast(channelObject_t * channel, localClock_t * clock, uint32_t messageSize, uint32_t bufferSize, uint8_t * buffer);
+/// Same as channelObject_createBroadcast() but the ringbuffer is double mapped (see ringBuffer_createMirrored())
+void channelObject_createBroadcastMirrored(channelObject_t * channel, localClock_t * clock, uint32_t messageSize, uint32_t bufferSize, uint8_t * buffer);
+/// Switch the channel to variable length mode: messageSize becomes the maximum message size and each event is stored with its actual size
+/// (the header of the events is CHANNEL_OBJECT_VARIABLE_HEADER_SIZE bytes long). Must be called before the first event is inserted.
+/// Events are inserted using channelObject_insertEventSized() or channelObject_commitEventSized()
+void channelObject_setVariableLength(channelObject_t * co);
+/// Use the given storage for the sinks of the channel instead of the MAX_CHANNEL_SINK sinks stored in the channel structure.
+/// Must be called before the first sink is allocated. The storage must be accessible by all processes that access the channel (see sharedMemory.h).
+/// @param maxSink number of sinks that fit into the storage
+/// @param storage uninitialized storage of maxSink sinks
+void channelObject_setSinkStorage(channelObject_t * co, uint32_t maxSink, channelObjectSink_t * storage);
 /// In case minimal latency is not 1 this can be set to a higher value using this method.
 /// Higher value improve the performance of the simulator but means higher event propagation time in the simulated domain.
 void channelObject_setMinimalLatency(channelObject_t * co, uint64_t minimalLatency);
@@ -96,6 +209,13 @@ void channelObject_setMinimalLatency(channelObject_t * co, uint64_t minimalLaten
 /// @param bufferSize size of the buffer in bytes that will be used as ringbuffer
 /// @param buffer buffer used as ringbuffer to store events that will be read by this channel sink
 channelObjectSink_t * channelObject_allocateSink(channelObject_t * channel, uint32_t bufferSize, uint8_t * buffer);
+/// Allocate a channel sink whose ringbuffer is double mapped (see ringBuffer_createMirrored()).
+/// Events are always continuous in such a ringbuffer so they are never copied into the read buffer and channelObject_reserveEvent() always fills them in place.
+/// @param bufferSize size of the buffer in bytes - power of two and multiple of the page size
+/// @param buffer double mapped buffer - see sharedMemory_allocateMirrored() and sharedMemory_mirrorRange()
+channelObjectSink_t * channelObject_allocateSinkMirrored(channelObject_t * channel, uint32_t bufferSize, uint8_t * buffer);
+/// Allocate a channel sink of a broadcast channel. The sink reads the ringbuffer of the channel.
+channelObjectSink_t * channelObject_allocateBroadcastSink(channelObject_t * channel);
 /// Wait until the timestamp is reached by the simulation of the channel.
 /// Process events stored in the sink until the given timestamp.
 /// Events are processed in order of their timestamps. Events processed are removed from the ringbuffer. the registered callback is executed for each event processed.
@@ -110,18 +230,107 @@ void channelObject_processEventsUntilNoWait(channelObjectSink_t * co, uint64_t t
 /// @param timestamp the required global timestamp
 /// @return the timestamp at which the event was finally enqued at. It is  more than the required timestamp if the minimalLatency requires it to be increased. Or when there is already an event in the queue then the timestamp is increased to be at least one more than the last enqueued event.
 uint64_t channelObject_insertEvent(channelObject_t * co, uint64_t timestamp, uint8_t * data);
+/// Add an event of the given size to the channel. Same as channelObject_insertEvent() but in variable length mode the size can be less than messageSize.
+/// @param size size of data in bytes. In fixed size mode it must be messageSize
+uint64_t channelObject_insertEventSized(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size);
+/// Add an array of events to the channel. The events are written into each ringbuffer with a single commit (or with as few commits as the free space of the ringbuffer allows)
+/// and simulatedUntil is updated once for the whole batch. The readers do not consume any event of the batch before simulatedUntil is updated so the whole batch
+/// (payload and the header of each event) must fit into the ringbuffer of each enabled sink (the broadcast ringbuffer in broadcast mode).
+/// @param timestamp the required global timestamp of the first event - increased the same way as in case of channelObject_insertEvent()
+/// @param nEvents number of events - at least 1
+/// @param data payload of the events
+/// @param sizes size of the events in bytes. NULL means all events are messageSize bytes long. Less than messageSize is only allowed in variable length mode.
+/// @param sameTimestamp true: all events get the same timestamp and are processed by the sinks as one group. false: event i is enqueued at timestamp+i
+/// @return the timestamp of the last event of the batch
+uint64_t channelObject_insertEvents(channelObject_t * co, uint64_t timestamp, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes, bool sameTimestamp);
+/// Set the temporary buffer used by channelObject_reserveEvent() in case the event can not be filled in place in the ringbuffer (when the event wraps around the end of the ringbuffer).
+/// Must be called before channelObject_reserveEvent() is used unless the first enabled sink is always mirrored.
+/// @param bufferSize size of buffer in bytes. Has to be at least messageSize
+/// @param buffer statically allocated buffer that is used by the writer of the channel
+void channelObject_setWriteBuffer(channelObject_t * co, uint32_t bufferSize, uint8_t * buffer);
+/// Reserve space for the next event of the channel so that the writer can fill the payload in place (no copy write).
+/// Blocks until the ringbuffers of the sinks have enough space - same as channelObject_insertEvent().
+/// The returned buffer is filled in place in the ringbuffer of the first enabled sink when the event is continuous in that ringbuffer
+/// otherwise the write buffer of the channel is returned. The event is not visible to the sinks until channelObject_commitEvent() is called.
+/// No other event can be inserted into the channel between reserve and commit.
+/// @param timestamp the required global timestamp - same as in case of channelObject_insertEvent()
+/// @return buffer to write messageSize bytes of payload into. (In variable length mode messageSize is the maximum size that can be committed.)
+uint8_t * channelObject_reserveEvent(channelObject_t * co, uint64_t timestamp);
+/// Publish the event reserved by channelObject_reserveEvent() to all enabled sinks.
+/// @return the timestamp at which the event was finally enqued at - same as in case of channelObject_insertEvent()
+uint64_t channelObject_commitEvent(channelObject_t * co);
+/// Publish the first size bytes of the event reserved by channelObject_reserveEvent() to all enabled sinks.
+/// @param size size of the payload in bytes. In fixed size mode it must be messageSize
+uint64_t channelObject_commitEventSized(channelObject_t * co, uint32_t size);
 /// Update the current time of the source - means that this object is simulated until the timestamp.
 /// This means that after the last event until this timestamp there is no event on the channel.
 /// All listeners of the channel can be simulated until this timestamp.
 void channelObject_updateTime(channelObject_t * co, uint64_t timestamp);
-/// Wait until the channel is simulated until the given time. Busy wait polling the simulatedUntil timestamp.
+/// The source declares that it will not insert events earlier than the timestamp. The listeners of the channel can be simulated until the timestamp before it.
+/// Events inserted earlier anyway are delayed to the timestamp (see channelObject_insertEvent())
+void channelObject_promiseNoEventBefore(channelObject_t * co, uint64_t timestamp);
+/// Wait until the channel is simulated until the given time. Polls the simulatedUntil timestamp then blocks according to the wait policy (see waitPolicy_set()).
 void channelObject_waitSimulatedUntil(channelObject_t * co, uint64_t timestamp);
+/// The poll callback of channelObject_waitSimulatedUntilPolling() is called in every CHANNEL_OBJECT_POLL_INTERVAL-th busy wait iteration. Must be a power of 2.
+#define CHANNEL_OBJECT_POLL_INTERVAL 64
+/// Called by channelObject_waitSimulatedUntilPolling() while waiting
+typedef void (*channelObjectPollCallback_t) (void * parameter);
+/// Same as channelObject_waitSimulatedUntil() but the poll callback is called at the start of the wait, after every CHANNEL_OBJECT_POLL_INTERVAL-th
+/// busy wait iteration and after each blocking wait - e.g. to take part in the time coordination of the clocks (see timeCoordinator.h)
+void channelObject_waitSimulatedUntilPolling(channelObject_t * co, uint64_t timestamp, channelObjectPollCallback_t poll, void * parameter);
 /// Enable/disable event propagation through the channel sink. Also sets up the callback object and the temporary buffer used
 /// to store the events currently being read.
-/// @param bufferSize size of buffer in bytes. Has to be at least messageSize+CHANNEL_OBJECT_HEADER_SIZE
+/// In broadcast mode enabling the sink drops all events that were written while it was disabled.
+/// @param bufferSize size of buffer in bytes. Has to be at least messageSize+CHANNEL_OBJECT_HEADER_SIZE (messageSize+CHANNEL_OBJECT_VARIABLE_HEADER_SIZE in variable length mode)
 /// @param buffer statically allocated buffer that is used by the sink object (in processEventsUntil and processEventsUntilNoWait) while the sink is active
 void channelObjectSink_setEnabled(channelObjectSink_t * sink, bool enabled, channelObjectEventCallback_t callback, void * parameter, uint32_t bufferSize, uint8_t * buffer);
+/// Allocate the pages of the ringbuffer of the sink on the NUMA node (see sharedMemory_bindToNode()). Usually called by the reader process with
+/// sharedMemory_currentNode() before the first event is written. Not supported for broadcast sinks: the ringbuffer is shared by all sinks.
+/// @return false when the NUMA policy could not be set
+bool channelObjectSink_bindToNode(channelObjectSink_t * sink, int node);
+/// Set the batch callback of the sink - see channelObjectBatchCallback_t. NULL means events are dispatched one by one to the callback set by channelObjectSink_setEnabled()
+/// Must be set before channelObjectSink_setEnabled() so that the read buffer of the sink is set up.
+void channelObjectSink_setBatchCallback(channelObjectSink_t * sink, channelObjectBatchCallback_t batchCallback);
+/// Iterate the events of a batch. Must only be called from the batch callback.
+/// @param[out] timestamp the global timestamp of the event
+/// @param[out] data set to the payload of the event. Points into the ringbuffer - or into the read buffer of the sink when the event wraps around the end of the ringbuffer.
+/// @param[out] size size of the payload in bytes
+/// @return false when there are no more events in the batch
+bool channelObjectSink_nextBatchEvent(channelObjectSink_t * sink, channelObjectBatch_t * batch, uint64_t * timestamp, uint8_t ** data, uint32_t * size);
+/// Optimistic mode: process events of the sink until the timestamp without waiting for the source and without removing them from the ringbuffer.
+/// Processing starts after the events already processed speculatively. The batch callback is not used in this mode - events are passed to the callback one by one.
+void channelObject_processEventsSpeculative(channelObjectSink_t * sink, uint64_t timestamp);
+/// Optimistic mode: remove the events processed speculatively before the position from the ringbuffer. They can not be rolled back any more.
+/// @param position a position returned by channelObjectSink_getSpeculativePosition()
+void channelObject_releaseSpeculative(channelObjectSink_t * sink, uint64_t position);
+/// Optimistic mode: the position of the next event to process - see speculativeReleased
+uint64_t channelObjectSink_getSpeculativePosition(channelObjectSink_t * sink);
+/// Optimistic mode: roll back the speculative processing to a position returned by channelObjectSink_getSpeculativePosition(). The events after it are processed again.
+void channelObjectSink_setSpeculativePosition(channelObjectSink_t * sink, uint64_t position);
+/// Optimistic mode: timestamp of the next event not processed speculatively. UINT64_MAX when there is no such event in the ringbuffer.
+/// The event may be sent speculatively by an optimistic source: it is committed only when simulatedUntil of the channel reaches its timestamp.
+uint64_t channelObjectSink_getNextSpeculativeTimeStamp(channelObjectSink_t * sink);
+/// Optimistic mode: earliest timestamp of the events cancelled by the source since the previous call. UINT64_MAX when no event was cancelled.
+/// The reader has to roll back when it processed the cancelled events speculatively (timestamp not later than its current time).
+uint64_t channelObjectSink_takeCancelled(channelObjectSink_t * sink);
+/// Optimistic source (see timeWarp.h): check whether events can be sent to every enabled sink without waiting for space
+/// @param payloadBytes size of the payload of the nEvents events - their headers are added
+bool channelObject_canSendSpeculative(channelObject_t * co, uint32_t nEvents, uint32_t payloadBytes);
+/// Optimistic source: write an event into the ringbuffers of the enabled sinks without updating simulatedUntil. Readers see the event but only optimistic readers
+/// process it before it is committed by channelObject_commitSpeculative(). There must be space for it - see channelObject_canSendSpeculative().
+/// @param[out] positions the write position of each ringbuffer - one per sink (UINT64_MAX for disabled sinks) or a single one in broadcast mode
+void channelObject_sendSpeculative(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size, uint64_t * positions);
+/// Optimistic source: cancel an event sent by channelObject_sendSpeculative() that is rolled back - see CHANNEL_OBJECT_CANCELLED.
+/// @param nPositions number of sinks when the event was sent (1 in broadcast mode)
+/// @param positions the positions returned by channelObject_sendSpeculative()
+void channelObject_cancelSpeculative(channelObject_t * co, uint64_t timestamp, uint32_t nPositions, const uint64_t * positions);
+/// Optimistic source: commit an event sent by channelObject_sendSpeculative(). The event is traced and simulatedUntil is set to its timestamp.
+void channelObject_commitSpeculative(channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size);
 /// Peek into the sink ringbuffer and read the next unprocessed timestamp in the event queue of the channel sink.
+/// The events are processed in order so only the timestamp of the first event is read.
+/// The timestamp is cached in the sink until the event is processed: the ringbuffer is only accessed when it was empty or the event was not committed at the previous call.
+/// Events sent speculatively by an optimistic source are not committed yet: simulatedUntil+1 is returned for them as the earliest possible time of the next event.
+/// Cancelled events at the read pointer are dropped.
 /// @return In case there is no event in the ringBuffer then UINT64_MAX is returned
 uint64_t channelObjectSink_getNextEventTimeStamp(channelObjectSink_t * sink);
 #endif
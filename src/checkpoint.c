@@ -0,0 +1,208 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "checkpoint.h"
+#include "assert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Identifies the clock files
+#define CHECKPOINT_CLOCK_MAGIC 0x4b4c4353u
+#define CHECKPOINT_VERSION 1
+
+/// Header of the clock file. Followed by nTimers checkpoint_timer_t and the model state.
+typedef struct
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t globalTime;
+  uint32_t nTimers;
+  uint32_t stateSize;
+  bool isrGlobalEnabled;
+  uint64_t isrsFlag;
+  uint64_t isrsEnabled;
+} checkpoint_clockHeader_t;
+
+/// Saved state of a timer - the callback is set by the process on restore
+typedef struct
+{
+  bool allocated;
+  bool enabled;
+  uint64_t timeoutAtGlobal;
+  uint64_t period;
+} checkpoint_timer_t;
+
+void checkpoint_create(checkpoint_t * cp, uint32_t nProcesses)
+{
+  assert(nProcesses>0);
+  cp->nProcesses=nProcesses;
+  atomic_init(&(cp->nArrived), 0);
+  atomic_init(&(cp->generation), 0);
+  waitPolicy_initEvent(&(cp->released));
+}
+
+void checkpoint_barrier(checkpoint_t * cp, localClock_t * lc)
+{
+  uint32_t generation=atomic_load_explicit(&(cp->generation), memory_order_acquire);
+  if(atomic_fetch_add_explicit(&(cp->nArrived), 1, memory_order_acq_rel)+1==cp->nProcesses)
+  {
+    // Last one - release the others
+    atomic_store_explicit(&(cp->nArrived), 0, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(cp->generation), 1, memory_order_release);
+    waitPolicy_notify(&(cp->released));
+    return;
+  }
+  uint32_t iteration=0;
+  while(atomic_load_explicit(&(cp->generation), memory_order_acquire)==generation)
+  {
+    localClock_checkExit(lc);
+    if(waitPolicy_shouldBlock(&iteration))
+    {
+      uint32_t sequence=waitPolicy_prepareWait(&(cp->released));
+      if(atomic_load_explicit(&(cp->generation), memory_order_acquire)==generation)
+      {
+        waitPolicy_wait(&(cp->released), sequence);
+      }else
+      {
+        waitPolicy_cancelWait(&(cp->released));
+      }
+    }else
+    {
+      waitPolicy_cpuRelax();
+    }
+  }
+}
+
+void checkpoint_take(checkpoint_t * cp, localClock_t * lc, uint64_t timestamp, const char * regionPath, const char * clockPath, bool master,
+    const void * region, uint64_t regionSize, uint32_t stateSize, localClock_stateCallback_t save, void * parameter)
+{
+  localClock_waitUntilGlobal(lc, timestamp);
+  checkpoint_saveClock(lc, clockPath, stateSize, save, parameter);
+  // All clocks are at the timestamp and nobody changes the shared memory until the second barrier
+  checkpoint_barrier(cp, lc);
+  if(master)
+  {
+    checkpoint_saveRegion(regionPath, region, regionSize);
+  }
+  checkpoint_barrier(cp, lc);
+}
+
+void checkpoint_saveRegion(const char * path, const void * region, uint64_t regionSize)
+{
+  FILE * f=fopen(path, "wb");
+  assertErrno(f!=NULL);
+  assertErrno(fwrite(region, 1, regionSize, f)==regionSize);
+  assertErrno(fclose(f)==0);
+}
+
+void checkpoint_loadRegion(const char * path, void * region, uint64_t regionSize)
+{
+  FILE * f=fopen(path, "rb");
+  assertErrno(f!=NULL);
+  assertMsg(fread(region, 1, regionSize, f)==regionSize, "Region file is shorter than the region");
+  assertErrno(fclose(f)==0);
+}
+
+void checkpoint_saveClock(localClock_t * lc, const char * path, uint32_t stateSize, localClock_stateCallback_t save, void * parameter)
+{
+  FILE * f=fopen(path, "wb");
+  assertErrno(f!=NULL);
+  checkpoint_clockHeader_t header;
+  // The structures are written as they are - the padding must not carry uninitialized bytes into the file
+  memset(&header, 0, sizeof(header));
+  header.magic=CHECKPOINT_CLOCK_MAGIC;
+  header.version=CHECKPOINT_VERSION;
+  header.globalTime=lc->globalTime;
+  header.nTimers=lc->nTimers;
+  header.stateSize=stateSize;
+  header.isrGlobalEnabled=lc->isrGlobalEnabled;
+  header.isrsFlag=lc->isrsFlag;
+  header.isrsEnabled=lc->isrsEnabled;
+  assertErrno(fwrite(&header, sizeof(header), 1, f)==1);
+  for(uint32_t i=0;i<lc->nTimers;++i)
+  {
+    checkpoint_timer_t timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.allocated=lc->timers[i].allocated;
+    timer.enabled=lc->timers[i].enabled;
+    timer.timeoutAtGlobal=lc->timers[i].timeoutAtGlobal;
+    timer.period=lc->timers[i].period;
+    assertErrno(fwrite(&timer, sizeof(timer), 1, f)==1);
+  }
+  if(stateSize>0)
+  {
+    uint8_t * state=malloc(stateSize);
+    assert(state!=NULL);
+    save(lc, parameter, state);
+    assertErrno(fwrite(state, stateSize, 1, f)==1);
+    free(state);
+  }
+  assertErrno(fclose(f)==0);
+}
+
+void checkpoint_restoreClock(localClock_t * lc, const char * path, uint32_t stateSize, localClock_stateCallback_t restore, void * parameter)
+{
+  FILE * f=fopen(path, "rb");
+  assertErrno(f!=NULL);
+  checkpoint_clockHeader_t header;
+  assertErrno(fread(&header, sizeof(header), 1, f)==1);
+  assertMsg(header.magic==CHECKPOINT_CLOCK_MAGIC && header.version==CHECKPOINT_VERSION, "Not a clock checkpoint file");
+  assertMsg(header.stateSize==stateSize, "Model state size differs from the checkpoint");
+  lc->globalTime=header.globalTime;
+  lc->isrGlobalEnabled=header.isrGlobalEnabled;
+  lc->isrsFlag=header.isrsFlag;
+  lc->isrsEnabled=header.isrsEnabled;
+  uint32_t nTimers=header.nTimers>lc->nTimers?header.nTimers:lc->nTimers;
+  for(uint32_t i=0;i<nTimers;++i)
+  {
+    checkpoint_timer_t timer;
+    if(i<header.nTimers)
+    {
+      assertErrno(fread(&timer, sizeof(timer), 1, f)==1);
+    }else
+    {
+      // Set up by the process but not known at the checkpoint - disabled
+      memset(&timer, 0, sizeof(timer));
+    }
+    if(i>=lc->nTimers)
+    {
+      // Timers may also be set by index without localClock_allocateTimer() - those are only known by being enabled
+      assertMsg(!timer.allocated && !timer.enabled, "Timer %u of the checkpoint is not set up", i);
+      continue;
+    }
+    // The process sets up its timers the same way on each start. The saved state overrides the arming of the setup - also when the timer is disabled.
+    assertMsg((!timer.allocated || lc->timers[i].allocated) && (!timer.enabled || lc->timers[i].callback!=NULL), "Timer %u of the checkpoint is not set up", i);
+    localClock_setTimer(lc, i, timer.enabled, timer.timeoutAtGlobal, timer.period, lc->timers[i].callback, lc->timers[i].parameter);
+  }
+  if(stateSize>0)
+  {
+    uint8_t * state=malloc(stateSize);
+    assert(state!=NULL);
+    assertErrno(fread(state, stateSize, 1, f)==1);
+    restore(lc, parameter, state);
+    free(state);
+  }
+  assertErrno(fclose(f)==0);
+}
@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_CHECKPOINT_H_
+#define SIMULATOR_CHECKPOINT_H_
+
+/// Checkpoint and restore of the whole simulation at a globally consistent simulated time.
+///
+/// All processes advance their clock to the checkpoint time and meet in a barrier. While all of them wait in the barrier the shared memory
+/// (channels, ringbuffers, simulatedUntil values) is not modified and the master process writes it into the region file.
+/// Each process writes the state of its clock (time, timers, ISR flags) and the state of its model into its own clock file.
+///
+/// Restore: the master restores the shared memory from the region file (sharedMemory_restore()) before the other processes are started.
+/// The channels in the region must not be created again. Each process sets up its clock as on a normal start (localClock_create(), registration,
+/// timer allocation with the callbacks, channelObjectSink_setEnabled() on its sinks so the callback pointers of this process are stored),
+/// then calls checkpoint_restoreClock(). The master also initializes the barrier again using checkpoint_create().
+/// The writer side pointers of the channels saved in the region (writeBuffer, pendingBuffer, pendingData) point into the memory of the process
+/// that took the checkpoint so they are stale: the writers call channelObject_setWriteBuffer() again and no event may be reserved at the checkpoint.
+
+#include "localClock.h"
+#include "waitPolicy.h"
+
+/// Barrier of the processes taking a checkpoint - stored in the shared memory
+typedef struct
+{
+  /// Number of processes taking part in the checkpoint
+  uint32_t nProcesses;
+  /// Number of processes arrived at the barrier
+  _Atomic uint32_t nArrived;
+  /// Incremented when all processes arrived
+  _Atomic uint32_t generation;
+  /// Notified when the barrier is released
+  waitPolicy_event_t released;
+} checkpoint_t;
+
+/// Initialize the barrier of the checkpoints
+/// @param nProcesses number of processes (or threads in threaded mode) that take the checkpoints together
+void checkpoint_create(checkpoint_t * cp, uint32_t nProcesses);
+/// Wait until all processes arrive at the barrier
+void checkpoint_barrier(checkpoint_t * cp, localClock_t * lc);
+/// Take a checkpoint at the given global time. Must be called by all processes with the same timestamp.
+/// @param regionPath file of the shared memory - written by the master only
+/// @param clockPath file of the state of the clock of this process
+/// @param master the master process writes the shared memory region
+/// @param region the shared memory region as returned by sharedMemory_open()
+/// @param regionSize size of the region in bytes
+/// @param stateSize size of the model state in bytes
+/// @param save saves the state of the model - may be NULL
+void checkpoint_take(checkpoint_t * cp, localClock_t * lc, uint64_t timestamp, const char * regionPath, const char * clockPath, bool master,
+    const void * region, uint64_t regionSize, uint32_t stateSize, localClock_stateCallback_t save, void * parameter);
+/// Write the shared memory region into a file
+void checkpoint_saveRegion(const char * path, const void * region, uint64_t regionSize);
+/// Read the shared memory region from a file written by checkpoint_saveRegion()
+void checkpoint_loadRegion(const char * path, void * region, uint64_t regionSize);
+/// Write the state of the clock and the model into a file
+void checkpoint_saveClock(localClock_t * lc, const char * path, uint32_t stateSize, localClock_stateCallback_t save, void * parameter);
+/// Restore the state of the clock and the model from a file written by checkpoint_saveClock(). The clock must be set up the same way as when
+/// the checkpoint was taken: the same timers allocated or set with their callbacks. Allocated and enabled timers are set again with the saved timeout and period.
+void checkpoint_restoreClock(localClock_t * lc, const char * path, uint32_t stateSize, localClock_stateCallback_t restore, void * parameter);
+
+#endif /* SIMULATOR_CHECKPOINT_H_ */
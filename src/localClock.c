@@ -24,14 +24,54 @@ SOFTWARE.
 
 #include "localClock.h"
 #include "channelObject.h"
+#include "timeCoordinator.h"
+#include "timeWarp.h"
+#include "recorder.h"
 #include "assert.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 // TODO implement slow down or speed up clock properly
 
+/// Grow the timer storage so that it has at least nTimers timers. The new timers are added to the free list.
+static void localClock_ensureTimers(localClock_t * lc, uint32_t nTimers);
+/// Timer heap ordering: earlier timeout first, lower index first in case of same timeout
+static inline bool localClock_timerBefore(localClock_t * lc, uint32_t a, uint32_t b);
+/// Restore the heap property by moving the timer at heap position pos towards the root or towards the leaves
+static void localClock_timerHeapFix(localClock_t * lc, uint32_t pos);
+/// Add the timer to the heap or update its position in the heap after its timeout was changed
+static void localClock_timerArm(localClock_t * lc, uint32_t timerIndex);
+/// Remove the timer from the heap
+static void localClock_timerDisarm(localClock_t * lc, uint32_t timerIndex);
+/// Execute the timers that elapsed until the timestamp. Each timer is executed at most once in a step.
+static void localClock_fireTimers(localClock_t * lc, uint64_t timestamp);
+/// Grow a registration array of the clock so that it can store at least n elements
+static void * localClock_growArray(void * array, uint32_t * capacity, uint32_t n, size_t elementSize);
+/// Key of a simulated input in the tournament tree: the input does not change until this timestamp
+static inline uint64_t localClock_inputKey(channelObjectSink_t * sink);
+/// The input of the two with the lower key. Lower index in case of same key. UINT32_MAX is an empty leaf.
+static inline uint32_t localClock_inputWinner(localClock_t * lc, uint32_t a, uint32_t b);
+/// Rebuild the tournament tree after an input was registered. All cached keys are reset to 0 so they are refreshed on the next step.
+static void localClock_inputTreeBuild(localClock_t * lc);
+/// Set the cached key of the input and replay the matches on the path to the root
+static void localClock_inputTreeUpdate(localClock_t * lc, uint32_t index, uint64_t key);
+/// Collect the inputs whose cached key is not more than the timestamp into inSimulateProcess
+static uint32_t localClock_inputTreeCollect(localClock_t * lc, uint32_t node, uint64_t timestamp, uint32_t n);
+/// Wait for the simulation of an input channel when the clock is attached to a GVT coordinator: the state of the clock is published while waiting
+/// and the outputs are marked simulated until the GVT when it is found.
+static void localClock_waitCoordinated(localClock_t * lc, channelObject_t * co, uint64_t timestamp, uint64_t targetGlobalTime);
+/// Poll callback of the coordinated wait: compute the GVT and mark the outputs simulated until it
+static void localClock_pollCoordinator(void * parameter);
+/// Optimistic mode step of the clock: roll back on straggler events, commit the final part of the simulation and advance speculatively (see timeWarp.h)
+static uint64_t localClock_tryAdvanceOptimistic(localClock_t * lc, uint64_t targetGlobalTime);
+/// Lookahead mode: the earliest timestamp when the clock may act after a step. The clock does not act before the target time of the step, the next timer or the next possible input event.
+static uint64_t localClock_horizon(localClock_t * lc, uint64_t targetGlobalTime);
+/// The earliest timestamp when the clock acts without input events: the target time of the step or the next timer
+static uint64_t localClock_timerHorizon(localClock_t * lc, uint64_t targetGlobalTime);
+
 void localClock_create(localClock_t * lc, uint64_t initialGlobalTime, uint64_t multiplierToLocal,
 		uint64_t multiplierTo_us, uint64_t multiplier_us_to_ticks, int64_t addGlobalToLocalTicks)
 {
@@ -39,15 +79,35 @@ void localClock_create(localClock_t * lc, uint64_t initialGlobalTime, uint64_t m
 	lc->multiplierToLocal=multiplierToLocal;
 	lc->multiplierTo_us=multiplierTo_us;
 	lc->multiplier_us_to_ticks=multiplier_us_to_ticks;
+	lc->lookahead=false;
+	lc->coordinator=NULL;
+	lc->coordinatorIndex=0;
+	lc->timeWarp=NULL;
+	lc->recorder=NULL;
+	lc->tracer=NULL;
 	lc->nChannelInFlush=0;
+	lc->maxChannelInFlush=0;
+	lc->channelsInFlush=NULL;
   lc->nChannelInSimulate=0;
+  lc->maxChannelInSimulate=0;
+  lc->channelsInSimulate=NULL;
+  lc->inSimulateKeys=NULL;
+  lc->inSimulateTree=NULL;
+  lc->inSimulateLeaves=0;
+  lc->inSimulateProcess=NULL;
 	lc->nChannelOut=0;
+	lc->maxChannelOut=0;
+	lc->channelsOut=NULL;
 	lc->addGlobalToLocalTicks=addGlobalToLocalTicks;
-	for(uint32_t i=0;i<CLOCK_N_TIMERS;++i)
-	{
-		lc->timers[i].enabled=false;
-    lc->timers[i].allocated=false;
-	}
+	lc->exit=false;
+	lc->threaded=false;
+	lc->thread=NULL;
+	lc->timers=NULL;
+	lc->nTimers=0;
+	lc->timerHeap=NULL;
+	lc->nTimerHeap=0;
+	lc->timersFired=NULL;
+	lc->freeTimer=CLOCK_TIMER_NOT_ARMED;
 	lc->isrGlobalEnabled=false;
   lc->isrsFlag=0u;
   lc->isrsEnabled=0u;
@@ -67,22 +127,115 @@ void localClock_setIsrHandler(localClock_t * lc, uint32_t isrIndex, localClock_i
 
 void localClock_registerChannel(localClock_t * lc, channelObject_t * channel)
 {
-	assert(lc->nChannelOut<CLOCK_MAX_CHANNELS);
+	lc->channelsOut=localClock_growArray(lc->channelsOut, &(lc->maxChannelOut), lc->nChannelOut+1, sizeof(channelObject_t *));
 	lc->channelsOut[lc->nChannelOut]=channel;
 	lc->nChannelOut++;
 }
 
 void localClock_registerSinkToFlush(localClock_t * lc, channelObjectSink_t * sink)
 {
-  assert(lc->nChannelInFlush<CLOCK_MAX_CHANNELS);
+  lc->channelsInFlush=localClock_growArray(lc->channelsInFlush, &(lc->maxChannelInFlush), lc->nChannelInFlush+1, sizeof(channelObjectSink_t *));
   lc->channelsInFlush[lc->nChannelInFlush]=sink;
   lc->nChannelInFlush++;
 }
 void localClock_registerSinkToSimulate(localClock_t * lc, channelObjectSink_t * sink)
 {
-  assert(lc->nChannelInSimulate<CLOCK_MAX_CHANNELS);
+  lc->channelsInSimulate=localClock_growArray(lc->channelsInSimulate, &(lc->maxChannelInSimulate), lc->nChannelInSimulate+1, sizeof(channelObjectSink_t *));
   lc->channelsInSimulate[lc->nChannelInSimulate]=sink;
   lc->nChannelInSimulate++;
+  localClock_inputTreeBuild(lc);
+}
+
+static void * localClock_growArray(void * array, uint32_t * capacity, uint32_t n, size_t elementSize)
+{
+  if(n>*capacity)
+  {
+    uint32_t newCapacity=*capacity==0?CLOCK_MAX_CHANNELS:*capacity;
+    while(newCapacity<n)
+    {
+      newCapacity*=2;
+    }
+    array=realloc(array, newCapacity*elementSize);
+    assert(array!=NULL);
+    *capacity=newCapacity;
+  }
+  return array;
+}
+
+static inline uint64_t localClock_inputKey(channelObjectSink_t * sink)
+{
+  uint64_t key=channelObjectSink_getHost(sink)->simulatedUntil;
+  uint64_t t=channelObjectSink_getNextEventTimeStamp(sink);
+  return t<key?t:key;
+}
+
+static inline uint32_t localClock_inputWinner(localClock_t * lc, uint32_t a, uint32_t b)
+{
+  if(b==UINT32_MAX)
+  {
+    return a;
+  }
+  if(a==UINT32_MAX)
+  {
+    return b;
+  }
+  return lc->inSimulateKeys[b]<lc->inSimulateKeys[a]?b:a;
+}
+
+static void localClock_inputTreeBuild(localClock_t * lc)
+{
+  uint32_t n=lc->nChannelInSimulate;
+  uint32_t leaves=1;
+  while(leaves<n)
+  {
+    leaves*=2;
+  }
+  lc->inSimulateLeaves=leaves;
+  lc->inSimulateKeys=realloc(lc->inSimulateKeys, n*sizeof(uint64_t));
+  lc->inSimulateTree=realloc(lc->inSimulateTree, 2*leaves*sizeof(uint32_t));
+  lc->inSimulateProcess=realloc(lc->inSimulateProcess, n*sizeof(uint32_t));
+  assert(lc->inSimulateKeys!=NULL && lc->inSimulateTree!=NULL && lc->inSimulateProcess!=NULL);
+  for(uint32_t i=0;i<leaves;++i)
+  {
+    if(i<n)
+    {
+      lc->inSimulateKeys[i]=0;
+      lc->inSimulateTree[leaves+i]=i;
+    }else
+    {
+      lc->inSimulateTree[leaves+i]=UINT32_MAX;
+    }
+  }
+  for(uint32_t node=leaves-1;node>=1;--node)
+  {
+    lc->inSimulateTree[node]=localClock_inputWinner(lc, lc->inSimulateTree[2*node], lc->inSimulateTree[2*node+1]);
+  }
+}
+
+static void localClock_inputTreeUpdate(localClock_t * lc, uint32_t index, uint64_t key)
+{
+  lc->inSimulateKeys[index]=key;
+  for(uint32_t node=(lc->inSimulateLeaves+index)/2;node>=1;node/=2)
+  {
+    lc->inSimulateTree[node]=localClock_inputWinner(lc, lc->inSimulateTree[2*node], lc->inSimulateTree[2*node+1]);
+  }
+}
+
+static uint32_t localClock_inputTreeCollect(localClock_t * lc, uint32_t node, uint64_t timestamp, uint32_t n)
+{
+  uint32_t index=lc->inSimulateTree[node];
+  if(index==UINT32_MAX || lc->inSimulateKeys[index]>timestamp)
+  {
+    // No input in this subtree can have an event until the timestamp
+    return n;
+  }
+  if(node>=lc->inSimulateLeaves)
+  {
+    lc->inSimulateProcess[n]=index;
+    return n+1;
+  }
+  n=localClock_inputTreeCollect(lc, 2*node, timestamp, n);
+  return localClock_inputTreeCollect(lc, 2*node+1, timestamp, n);
 }
 
 
@@ -139,15 +292,63 @@ uint64_t localClock_get_us(localClock_t * lc)
 	value>>=32;
 	return value/1000;
 }
+/// Threaded mode: the clock simulated by the current thread. Waiting loops check the exit flag of the clock they wait for (the source of a channel)
+/// so the exit flag of the waiting clock is checked using this.
+static _Thread_local localClock_t * threadClock=NULL;
+
 void localClock_checkExit(localClock_t * lc)
 {
-  if(lc->exit)
+  if(lc->exit || (threadClock!=NULL && threadClock->exit))
   {
     printf("Exit requested by simulator - normal exit\n");
     fflush(stdout);
+    if(threadClock!=NULL)
+    {
+      pthread_exit(NULL);
+    }
     exit(0);
   }
 }
+void localClock_requestExit(localClock_t * lc)
+{
+  lc->exit=true;
+}
+
+/// The thread of a clock in threaded mode - allocated by localClock_startThread() and freed by localClock_joinThread()
+typedef struct
+{
+  pthread_t thread;
+  localClock_t * lc;
+  localClock_threadMain_t threadMain;
+  void * parameter;
+} localClock_thread_t;
+
+static void * localClock_threadStart(void * parameter)
+{
+  localClock_thread_t * t=parameter;
+  threadClock=t->lc;
+  t->threadMain(t->lc, t->parameter);
+  return NULL;
+}
+void localClock_startThread(localClock_t * lc, localClock_threadMain_t threadMain, void * parameter)
+{
+  localClock_thread_t * t=malloc(sizeof(localClock_thread_t));
+  assert(t!=NULL);
+  t->lc=lc;
+  t->threadMain=threadMain;
+  t->parameter=parameter;
+  lc->threaded=true;
+  lc->thread=t;
+  assert(pthread_create(&(t->thread), NULL, localClock_threadStart, t)==0);
+}
+void localClock_joinThread(localClock_t * lc)
+{
+  localClock_thread_t * t=lc->thread;
+  assert(lc->threaded && t!=NULL);
+  assert(pthread_join(t->thread, NULL)==0);
+  free(t);
+  lc->thread=NULL;
+}
 static inline void localClock_processIsrs(localClock_t * lc)
 {
   uint64_t enabledAndActive;
@@ -160,6 +361,10 @@ static inline void localClock_processIsrs(localClock_t * lc)
 }
 uint64_t localClock_tryAdvanceTimeGlobal(localClock_t * lc, uint64_t targetGlobalTime)
 {
+  if(lc->timeWarp!=NULL)
+  {
+    return localClock_tryAdvanceOptimistic(lc, targetGlobalTime);
+  }
   localClock_processIsrs(lc);
   uint64_t ret=UINT64_MAX;
 //  int32_t channelIndex=-1;
@@ -167,37 +372,36 @@ uint64_t localClock_tryAdvanceTimeGlobal(localClock_t * lc, uint64_t targetGloba
   //bool retry=false;
   //bool waited=false;
   uint64_t now=lc->globalTime;
-    for(int32_t i=0;i<lc->nChannelInSimulate;++i)
+    // The winner of the tournament tree is refreshed until its key does not change: the cached keys of the other inputs are not more than their current key
+    // so the key of the winner is the minimum of all inputs. Waiting for the simulation of the winner until it is ahead of now means all inputs are ahead.
+    while(lc->nChannelInSimulate>0)
     {
-      channelObjectSink_t * channelIn=lc->channelsInSimulate[i];
-      uint64_t t=channelIn->host->simulatedUntil;
-      if(t<=now)
+      uint32_t index=lc->inSimulateTree[1];
+      channelObjectSink_t * channelIn=lc->channelsInSimulate[index];
+      if(channelObjectSink_getHost(channelIn)->simulatedUntil<=now)
       {
-        channelObject_waitSimulatedUntil(channelIn->host, now+1);
-      }
-      t=channelIn->host->simulatedUntil;
-      if(t<ret)
-      {
-        ret=t;
-//        channelIndex=i;
+        if(lc->coordinator!=NULL)
+        {
+          localClock_waitCoordinated(lc, channelObjectSink_getHost(channelIn), now+1, targetGlobalTime);
+        }else
+        {
+          channelObject_waitSimulatedUntil(channelObjectSink_getHost(channelIn), now+1);
+        }
       }
-      t=channelObjectSink_getNextEventTimeStamp(channelIn);
-      if(t<ret)
+      uint64_t t=localClock_inputKey(channelIn);
+      if(t==lc->inSimulateKeys[index])
       {
         ret=t;
-//        channelIndex=i;
+        break;
       }
+      localClock_inputTreeUpdate(lc, index, t);
     }
-    for(int32_t i=0;i<CLOCK_N_TIMERS;++i)
+    if(lc->nTimerHeap>0)
     {
-      if(lc->timers[i].enabled)
+      uint64_t t=lc->timers[lc->timerHeap[0]].timeoutAtGlobal;
+      if(t<ret)
       {
-        if(lc->timers[i].timeoutAtGlobal<ret)
-        {
-          ret=lc->timers[i].timeoutAtGlobal;
-//          timerIndex=i;
-//          channelIndex=-1;
-        }
+        ret=t;
       }
     }
   if(ret>targetGlobalTime)
@@ -208,39 +412,242 @@ uint64_t localClock_tryAdvanceTimeGlobal(localClock_t * lc, uint64_t targetGloba
   {
     lc->globalTime=ret;
   }
-  for(int32_t i=0;i<CLOCK_N_TIMERS;++i)
+  localClock_fireTimers(lc, ret);
+  for(uint32_t i=0;i<lc->nChannelOut;++i)
+  {
+    channelObject_t * channelOut=lc->channelsOut[i];
+    channelObject_updateTime(channelOut, ret);
+  }
+  for(uint32_t i=0;i<lc->nChannelInFlush;++i)
+  {
+    channelObjectSink_t * channelIn=lc->channelsInFlush[i];
+    channelObject_processEventsUntilNoWait(channelIn, ret);
+  }
+  if(lc->nChannelInSimulate>0)
   {
-    if(lc->timers[i].enabled)
+    // Only the inputs that may have events until ret are processed
+    uint32_t n=localClock_inputTreeCollect(lc, 1, ret, 0);
+    for(uint32_t i=0;i<n;++i)
     {
-      if(lc->timers[i].timeoutAtGlobal<=ret)
+      uint32_t index=lc->inSimulateProcess[i];
+      channelObjectSink_t * channelIn=lc->channelsInSimulate[index];
+      channelObject_processEventsUntil(channelIn, ret);
+      localClock_inputTreeUpdate(lc, index, localClock_inputKey(channelIn));
+    }
+  }
+  localClock_processIsrs(lc);
+  if(lc->recorder!=NULL)
+  {
+    recorder_step(lc->recorder, ret);
+  }
+  if(lc->lookahead)
+  {
+    // Nothing happens until the horizon so the outputs are known until the timestamp before it
+    uint64_t horizon=localClock_horizon(lc, targetGlobalTime);
+    if(horizon>ret+1)
+    {
+      for(uint32_t i=0;i<lc->nChannelOut;++i)
       {
-        if(lc->timers[i].period>0)
-        {
-          lc->timers[i].timeoutAtGlobal+=lc->timers[i].period;
-        }else
-        {
-          lc->timers[i].enabled=false;
-        }
-        lc->timers[i].callback(lc->timers[i].parameter);
+        channelObject_updateTime(lc->channelsOut[i], horizon-1);
+      }
+    }
+  }
+  return ret;
+}
+
+void localClock_setOptimistic(localClock_t * lc, uint32_t maxSnapshots, uint32_t stateSize, localClock_stateCallback_t save, localClock_stateCallback_t restore, void * parameter)
+{
+  assert(lc->timeWarp==NULL);
+  lc->timeWarp=timeWarp_create(maxSnapshots, stateSize, save, restore, parameter);
+  lc->timeWarp->committedUntil=lc->globalTime;
+}
+
+static uint64_t localClock_tryAdvanceOptimistic(localClock_t * lc, uint64_t targetGlobalTime)
+{
+  localClock_processIsrs(lc);
+  uint64_t now=lc->globalTime;
+  uint64_t safe=UINT64_MAX;
+  channelObjectSink_t * slowest=NULL;
+  uint64_t next=UINT64_MAX;
+  uint64_t straggler=UINT64_MAX;
+  for(uint32_t i=0;i<lc->nChannelInSimulate+lc->nChannelInFlush;++i)
+  {
+    channelObjectSink_t * channelIn=i<lc->nChannelInSimulate?lc->channelsInSimulate[i]:lc->channelsInFlush[i-lc->nChannelInSimulate];
+    if(i<lc->nChannelInSimulate && channelObjectSink_getHost(channelIn)->simulatedUntil<safe)
+    {
+      // Read before the events: all events until simulatedUntil are already in the ringbuffer
+      safe=channelObjectSink_getHost(channelIn)->simulatedUntil;
+      slowest=channelIn;
+    }
+    uint64_t t=channelObjectSink_getNextSpeculativeTimeStamp(channelIn);
+    if(i<lc->nChannelInSimulate)
+    {
+      // Events processed speculatively and cancelled by an optimistic source are rolled back the same way as stragglers
+      uint64_t cancelled=channelObjectSink_takeCancelled(channelIn);
+      if(t>cancelled)
+      {
+        t=cancelled;
+      }
+      if(t<=now && t<straggler)
+      {
+        straggler=t;
       }
+    }else if(t>channelObjectSink_getHost(channelIn)->simulatedUntil)
+    {
+      // Flush inputs are not waited for in conservative mode either - their late events are processed late instead of a rollback.
+      // Only their committed events are processed (see below) so a speculative one does not move the clock.
+      t=UINT64_MAX;
     }
+    if(t<next)
+    {
+      next=t;
+    }
+  }
+  if(straggler!=UINT64_MAX)
+  {
+    timeWarp_rollback(lc, straggler);
+    return lc->globalTime;
   }
+  timeWarp_commit(lc, safe);
+  uint64_t ret=localClock_timerHorizon(lc, targetGlobalTime);
+  if(next<ret)
+  {
+    ret=next;
+  }
+  if(ret>now && ret>safe && !timeWarp_snapshot(lc))
+  {
+    // Too far ahead of the inputs
+    ret=now;
+  }
+  if(ret<=now)
+  {
+    if(slowest!=NULL && safe<now)
+    {
+      channelObject_waitSimulatedUntil(channelObjectSink_getHost(slowest), safe+1);
+    }
+    return now;
+  }
+  lc->globalTime=ret;
+  localClock_fireTimers(lc, ret);
+  for(uint32_t i=0;i<lc->nChannelInSimulate+lc->nChannelInFlush;++i)
+  {
+    channelObjectSink_t * channelIn=i<lc->nChannelInSimulate?lc->channelsInSimulate[i]:lc->channelsInFlush[i-lc->nChannelInSimulate];
+    uint64_t until=ret;
+    if(i>=lc->nChannelInSimulate)
+    {
+      // Flush inputs are released at each commit so only their committed events are processed.
+      // Read before the events - the events until it are in the ringbuffer and can not be cancelled any more
+      uint64_t committed=channelObjectSink_getHost(channelIn)->simulatedUntil;
+      atomic_thread_fence(memory_order_acquire);
+      if(committed<until)
+      {
+        until=committed;
+      }
+    }
+    channelObject_processEventsSpeculative(channelIn, until);
+  }
+  localClock_processIsrs(lc);
+  if(ret<=safe)
+  {
+    timeWarp_commit(lc, safe);
+  }
+  return ret;
+}
+
+void localClock_setLookahead(localClock_t * lc, bool enabled)
+{
+  lc->lookahead=enabled;
+}
+
+bool localClock_bindInputsToNode(localClock_t * lc, int node)
+{
+  bool ret=true;
+  for(uint32_t i=0;i<lc->nChannelInSimulate+lc->nChannelInFlush;++i)
+  {
+    channelObjectSink_t * sink=i<lc->nChannelInSimulate?lc->channelsInSimulate[i]:lc->channelsInFlush[i-lc->nChannelInSimulate];
+    if(!channelObjectSink_getHost(sink)->broadcast)
+    {
+      ret=channelObjectSink_bindToNode(sink, node) && ret;
+    }
+  }
+  return ret;
+}
+
+void localClock_setCoordinator(localClock_t * lc, timeCoordinator_t * coordinator)
+{
+  lc->coordinator=coordinator;
+  lc->coordinatorIndex=timeCoordinator_attach(coordinator);
+}
+
+static void localClock_pollCoordinator(void * parameter)
+{
+  localClock_t * lc=parameter;
+  uint64_t gvt=timeCoordinator_compute(lc->coordinator);
+  if(gvt>lc->globalTime+1)
+  {
+    // No clock acts before the GVT
+    for(uint32_t i=0;i<lc->nChannelOut;++i)
+    {
+      channelObject_updateTime(lc->channelsOut[i], gvt-1);
+    }
+  }
+}
+
+static void localClock_waitCoordinated(localClock_t * lc, channelObject_t * co, uint64_t timestamp, uint64_t targetGlobalTime)
+{
+  timeCoordinator_t * tc=lc->coordinator;
+  uint64_t sent=0;
+  uint64_t observed=0;
   for(uint32_t i=0;i<lc->nChannelOut;++i)
   {
     channelObject_t * channelOut=lc->channelsOut[i];
-    channelObject_updateTime(channelOut, ret);
+    sent+=atomic_load_explicit(&(channelOut->nEventsInserted), memory_order_relaxed)*channelOut->nSink;
   }
-  for(uint32_t i=0;i<lc->nChannelInFlush;++i)
+  // The counters are read before the ringbuffers: all events counted are visible when the next event timestamps are read
+  uint64_t horizon=localClock_timerHorizon(lc, targetGlobalTime);
+  for(uint32_t i=0;i<lc->nChannelInSimulate+lc->nChannelInFlush;++i)
   {
-    channelObjectSink_t * channelIn=lc->channelsInFlush[i];
-    channelObject_processEventsUntilNoWait(channelIn, ret);
+    channelObjectSink_t * sink=i<lc->nChannelInSimulate?lc->channelsInSimulate[i]:lc->channelsInFlush[i-lc->nChannelInSimulate];
+    observed+=atomic_load_explicit(&(channelObjectSink_getHost(sink)->nEventsInserted), memory_order_acquire);
+    uint64_t t=channelObjectSink_getNextEventTimeStamp(sink);
+    if(t<horizon)
+    {
+      horizon=t;
+    }
   }
-  for(uint32_t i=0;i<lc->nChannelInSimulate;++i)
+  timeCoordinator_setWaiting(tc, lc->coordinatorIndex, horizon, sent, observed);
+  // The GVT reads the entries of all clocks - only computed in every CHANNEL_OBJECT_POLL_INTERVAL-th iteration of the wait
+  channelObject_waitSimulatedUntilPolling(co, timestamp, localClock_pollCoordinator, lc);
+  timeCoordinator_setActive(tc, lc->coordinatorIndex);
+}
+
+static uint64_t localClock_timerHorizon(localClock_t * lc, uint64_t targetGlobalTime)
+{
+  uint64_t ret=targetGlobalTime;
+  if(lc->nTimerHeap>0 && lc->timers[lc->timerHeap[0]].timeoutAtGlobal<ret)
   {
-    channelObjectSink_t * channelIn=lc->channelsInSimulate[i];
-    channelObject_processEventsUntil(channelIn, ret);
+    ret=lc->timers[lc->timerHeap[0]].timeoutAtGlobal;
+  }
+  return ret;
+}
+
+static uint64_t localClock_horizon(localClock_t * lc, uint64_t targetGlobalTime)
+{
+  uint64_t ret=localClock_timerHorizon(lc, targetGlobalTime);
+  // Cached key of the winner is not more than the key of any input - a new event may arrive right after simulatedUntil of the input
+  if(lc->nChannelInSimulate>0 && lc->inSimulateKeys[lc->inSimulateTree[1]]<ret)
+  {
+    ret=lc->inSimulateKeys[lc->inSimulateTree[1]];
+  }
+  // Flush inputs are not waited for but their events are processed by the clock - a late event may arrive right after their simulatedUntil too
+  for(uint32_t i=0;i<lc->nChannelInFlush;++i)
+  {
+    uint64_t t=localClock_inputKey(lc->channelsInFlush[i]);
+    if(t<ret)
+    {
+      ret=t;
+    }
   }
-  localClock_processIsrs(lc);
   return ret;
 }
 
@@ -294,7 +701,8 @@ void localClock_setIsrActive(localClock_t * lc, uint32_t isrIndex, bool active)
 static void localClock_advanceTimeGlobal(localClock_t * lc, uint64_t targetGlobalTime)
 {
   uint64_t ret=lc->globalTime;
-  while(ret<targetGlobalTime)
+  // Optimistic mode: the caller continues only when the simulation can not be rolled back before the target
+  while(ret<targetGlobalTime || (lc->timeWarp!=NULL && lc->timeWarp->committedUntil<targetGlobalTime))
   {
     ret=localClock_tryAdvanceTimeGlobal(lc, targetGlobalTime);
   }
@@ -328,28 +736,208 @@ void localClock_waitUntilGlobal(localClock_t * lc, uint64_t targetGlobalTime)
 }
 void localClock_setTimer(localClock_t * lc, uint32_t timerIndex, bool enabled, uint64_t timeoutAt, uint64_t period, localClock_timerCallback_t callback, void * param)
 {
-	assert(timerIndex<CLOCK_N_TIMERS);
-	lc->timers[timerIndex].enabled=enabled;
-	lc->timers[timerIndex].timeoutAtGlobal=timeoutAt;
-	lc->timers[timerIndex].period=period;
-	lc->timers[timerIndex].callback=callback;
-	lc->timers[timerIndex].parameter=param;
+  assert(timerIndex<CLOCK_TIMER_NOT_ARMED);
+  localClock_ensureTimers(lc, timerIndex+1);
+  localClock_timer_t * timer=&(lc->timers[timerIndex]);
+	timer->enabled=enabled;
+	timer->timeoutAtGlobal=timeoutAt;
+	timer->period=period;
+	timer->callback=callback;
+	timer->parameter=param;
+	if(enabled)
+	{
+	  localClock_timerArm(lc, timerIndex);
+	}else
+	{
+	  localClock_timerDisarm(lc, timerIndex);
+	}
 }
 uint32_t localClock_allocateTimer(localClock_t * lc)
 {
-  for(uint32_t i=0;i<CLOCK_N_TIMERS;++i)
+  if(lc->freeTimer==CLOCK_TIMER_NOT_ARMED)
+  {
+    localClock_ensureTimers(lc, lc->nTimers+1);
+  }
+  uint32_t index=lc->freeTimer;
+  lc->freeTimer=lc->timers[index].nextFree;
+  lc->timers[index].allocated=true;
+  return index;
+}
+void localClock_releaseTimer(localClock_t * lc, uint32_t timerIndex)
+{
+  assert(timerIndex<lc->nTimers);
+  if(lc->timers[timerIndex].allocated)
+  {
+    lc->timers[timerIndex].allocated=false;
+    lc->timers[timerIndex].nextFree=lc->freeTimer;
+    lc->freeTimer=timerIndex;
+  }
+}
+void localClock_destroy(localClock_t * lc)
+{
+  if(lc->timeWarp!=NULL)
+  {
+    timeWarp_destroy(lc->timeWarp);
+    lc->timeWarp=NULL;
+  }
+  free(lc->channelsOut);
+  free(lc->channelsInFlush);
+  free(lc->channelsInSimulate);
+  free(lc->inSimulateKeys);
+  free(lc->inSimulateTree);
+  free(lc->inSimulateProcess);
+  lc->channelsOut=NULL;
+  lc->channelsInFlush=NULL;
+  lc->channelsInSimulate=NULL;
+  lc->inSimulateKeys=NULL;
+  lc->inSimulateTree=NULL;
+  lc->inSimulateProcess=NULL;
+  lc->nChannelOut=lc->maxChannelOut=0;
+  lc->nChannelInFlush=lc->maxChannelInFlush=0;
+  lc->nChannelInSimulate=lc->maxChannelInSimulate=0;
+  lc->inSimulateLeaves=0;
+  free(lc->timers);
+  free(lc->timerHeap);
+  free(lc->timersFired);
+  lc->timers=NULL;
+  lc->timerHeap=NULL;
+  lc->timersFired=NULL;
+  lc->nTimers=0;
+  lc->nTimerHeap=0;
+  lc->freeTimer=CLOCK_TIMER_NOT_ARMED;
+}
+
+static void localClock_ensureTimers(localClock_t * lc, uint32_t nTimers)
+{
+  if(nTimers<=lc->nTimers)
+  {
+    return;
+  }
+  uint32_t n=lc->nTimers==0?CLOCK_N_TIMERS:lc->nTimers;
+  while(n<nTimers)
+  {
+    n*=2;
+  }
+  lc->timers=realloc(lc->timers, n*sizeof(localClock_timer_t));
+  lc->timerHeap=realloc(lc->timerHeap, n*sizeof(uint32_t));
+  lc->timersFired=realloc(lc->timersFired, n*sizeof(uint32_t));
+  assert(lc->timers!=NULL && lc->timerHeap!=NULL && lc->timersFired!=NULL);
+  // Added to the free list in reverse order so that lower indexes are allocated first
+  for(uint32_t i=n;i>lc->nTimers;--i)
+  {
+    localClock_timer_t * timer=&(lc->timers[i-1]);
+    timer->enabled=false;
+    timer->allocated=false;
+    timer->heapIndex=CLOCK_TIMER_NOT_ARMED;
+    timer->nextFree=lc->freeTimer;
+    lc->freeTimer=i-1;
+  }
+  lc->nTimers=n;
+}
+
+static inline bool localClock_timerBefore(localClock_t * lc, uint32_t a, uint32_t b)
+{
+  uint64_t ta=lc->timers[a].timeoutAtGlobal;
+  uint64_t tb=lc->timers[b].timeoutAtGlobal;
+  return ta<tb || (ta==tb && a<b);
+}
+
+static void localClock_timerHeapFix(localClock_t * lc, uint32_t pos)
+{
+  uint32_t * heap=lc->timerHeap;
+  uint32_t index=heap[pos];
+  while(pos>0)
+  {
+    uint32_t parent=(pos-1)/2;
+    if(!localClock_timerBefore(lc, index, heap[parent]))
+    {
+      break;
+    }
+    heap[pos]=heap[parent];
+    lc->timers[heap[pos]].heapIndex=pos;
+    pos=parent;
+  }
+  while(true)
+  {
+    uint32_t child=2*pos+1;
+    if(child>=lc->nTimerHeap)
+    {
+      break;
+    }
+    if(child+1<lc->nTimerHeap && localClock_timerBefore(lc, heap[child+1], heap[child]))
+    {
+      child++;
+    }
+    if(!localClock_timerBefore(lc, heap[child], index))
+    {
+      break;
+    }
+    heap[pos]=heap[child];
+    lc->timers[heap[pos]].heapIndex=pos;
+    pos=child;
+  }
+  heap[pos]=index;
+  lc->timers[index].heapIndex=pos;
+}
+
+static void localClock_timerArm(localClock_t * lc, uint32_t timerIndex)
+{
+  uint32_t pos=lc->timers[timerIndex].heapIndex;
+  if(pos==CLOCK_TIMER_NOT_ARMED)
+  {
+    pos=lc->nTimerHeap;
+    lc->timerHeap[pos]=timerIndex;
+    lc->nTimerHeap++;
+  }
+  localClock_timerHeapFix(lc, pos);
+}
+
+static void localClock_timerDisarm(localClock_t * lc, uint32_t timerIndex)
+{
+  uint32_t pos=lc->timers[timerIndex].heapIndex;
+  if(pos!=CLOCK_TIMER_NOT_ARMED)
   {
-    if(!lc->timers[i].allocated)
+    lc->timers[timerIndex].heapIndex=CLOCK_TIMER_NOT_ARMED;
+    lc->nTimerHeap--;
+    if(pos<lc->nTimerHeap)
     {
-      lc->timers[i].allocated=true;
-      return i;
+      // Move the last timer into the hole
+      lc->timerHeap[pos]=lc->timerHeap[lc->nTimerHeap];
+      localClock_timerHeapFix(lc, pos);
     }
   }
-  assert(false);
 }
-void localClock_releaseTimer(localClock_t * lc, uint32_t timerIndex)
+
+static void localClock_fireTimers(localClock_t * lc, uint64_t timestamp)
 {
-  lc->timers[timerIndex].allocated=false;
+  uint32_t nFired=0;
+  // Collect the elapsed timers first so that a periodic timer rescheduled into this step is not executed twice
+  while(lc->nTimerHeap>0 && lc->timers[lc->timerHeap[0]].timeoutAtGlobal<=timestamp)
+  {
+    uint32_t index=lc->timerHeap[0];
+    localClock_timerDisarm(lc, index);
+    lc->timersFired[nFired]=index;
+    nFired++;
+  }
+  for(uint32_t i=0;i<nFired;++i)
+  {
+    uint32_t index=lc->timersFired[i];
+    localClock_timer_t * timer=&(lc->timers[index]);
+    if(!timer->enabled || timer->heapIndex!=CLOCK_TIMER_NOT_ARMED)
+    {
+      // Disabled or set again by the callback of an other timer of this step
+      continue;
+    }
+    if(timer->period>0)
+    {
+      timer->timeoutAtGlobal+=timer->period;
+      localClock_timerArm(lc, index);
+    }else
+    {
+      timer->enabled=false;
+    }
+    timer->callback(timer->parameter);
+  }
 }
 
 uint64_t localClock_us_to_ticks(localClock_t * lc, uint64_t us)
@@ -31,10 +31,12 @@ SOFTWARE.
 #include "simulator_types.h"
 struct channelObject_str;
 
-/// Maximum number of channels (source) associated with a clock. If has to be increased it only increases RAM usage
+/// Initial number of channels of each kind registered with a clock. The registration arrays grow when more channels are registered.
 #define CLOCK_MAX_CHANNELS 8
-/// Maximum number of timers associated with a clock. If has to be increased it only increases RAM usage
+/// Initial number of timers associated with a clock. The timer storage is allocated on first use and grows when more timers are needed.
 #define CLOCK_N_TIMERS 8
+/// heapIndex of timers that are not armed (not in the timer heap)
+#define CLOCK_TIMER_NOT_ARMED UINT32_MAX
 /// Number of ISRs
 #define ISR_N 64
 
@@ -54,6 +56,7 @@ typedef void (*localClock_isrCallback_t) (struct localClock_members * clk, uint3
 
 /// A timer connected to the local clock
 /// Both timeoutAt and period are measured in global timestamps!
+/// Enabled timers are kept in a min-heap ordered by timeoutAtGlobal so the fields must only be changed using localClock_setTimer()
 typedef struct
 {
 	volatile bool enabled;
@@ -62,6 +65,10 @@ typedef struct
 	localClock_timerCallback_t callback;
 	void * parameter;
   bool allocated;
+  /// Position of the timer in the timer heap of the clock. CLOCK_TIMER_NOT_ARMED when the timer is not in the heap.
+  uint32_t heapIndex;
+  /// Next timer in the list of not allocated timers
+  uint32_t nextFree;
 } localClock_timer_t;
 
 /// An interrupt handler connected to the local clock
@@ -83,27 +90,75 @@ typedef struct localClock_members
   int64_t addGlobalToLocalTicks;
 	uint64_t multiplier_us_to_ticks;
 	uint32_t nChannelOut;
+	uint32_t maxChannelOut;
 	/// All output channels sourced by this clock domain. When time is advanced all output is marked to be simulated until this time
-	struct channelObject_str * channelsOut[CLOCK_MAX_CHANNELS];
+	/// The registration arrays are process local memory allocated on demand - only accessed by the simulator of the clock.
+	struct channelObject_str ** channelsOut;
 	uint32_t nChannelInSimulate;
+	uint32_t maxChannelInSimulate;
 	/// TODO implement - All input channels that are capable of triggering interrupt (pin change interrupt, UART interrupt, etc.)
 	/// Time is advancement is blocked until the simulation of these input channels is ready and these are all scanned for events when advancing time.
-	struct channelObjectSink_str * channelsInSimulate[CLOCK_MAX_CHANNELS];
+	struct channelObjectSink_str ** channelsInSimulate;
+	/// Tournament tree of channelsInSimulate: the key of each input is min(simulatedUntil, next event timestamp) of the channel sink.
+	/// Keys only increase so the cached keys are refreshed lazily: only the winner is re-read from the channel until its key does not change.
+	/// Cached key of each input - not more than the current key of the input
+	uint64_t * inSimulateKeys;
+	/// Winner tree: node 1 is the root, node i has children 2i and 2i+1, leaf j is node inSimulateLeaves+j. Each node stores the index of the input with the lowest key in its subtree.
+	uint32_t * inSimulateTree;
+	/// Number of leaves of the tree - power of 2
+	uint32_t inSimulateLeaves;
+	/// Temporary storage of the inputs to be processed in a single step of the clock
+	uint32_t * inSimulateProcess;
   uint32_t nChannelInFlush;
+  uint32_t maxChannelInFlush;
   /// All input channels that are to be flushed so that the ringbuffer does not block the writer side.
   /// Blocking wait for time advancement is not necessary.
-  struct channelObjectSink_str * channelsInFlush[CLOCK_MAX_CHANNELS];
- 	localClock_timer_t timers[CLOCK_N_TIMERS];
+  struct channelObjectSink_str ** channelsInFlush;
+ 	/// Timer storage - allocated on demand, indexed by timer index. Process local memory: timers are only accessed by the simulator of the clock.
+ 	localClock_timer_t * timers;
+ 	/// Number of timers in the timer storage
+ 	uint32_t nTimers;
+ 	/// Min-heap of the indexes of enabled timers ordered by (timeoutAtGlobal, index). The first is the next timer to fire.
+ 	uint32_t * timerHeap;
+ 	uint32_t nTimerHeap;
+ 	/// Temporary storage of the timers fired in a single step of the clock
+ 	uint32_t * timersFired;
+ 	/// First not allocated timer. CLOCK_TIMER_NOT_ARMED when all timers are allocated.
+ 	uint32_t freeTimer;
  	bool isrGlobalEnabled;
  	uint64_t isrsFlag;
   uint64_t isrsEnabled;
   localClock_isr_t isrs[ISR_N];
+ 	/// Optional GVT coordinator shared with the other clocks (see localClock_setCoordinator())
+ 	struct timeCoordinator_str * coordinator;
+ 	/// Index of the entry of this clock in the coordinator
+ 	uint32_t coordinatorIndex;
+ 	/// Optimistic mode state - NULL in conservative mode (see localClock_setOptimistic())
+ 	struct timeWarp_str * timeWarp;
+ 	/// Recorder of the inputs of the clock - NULL when not recording (see recorder.h)
+ 	struct recorder_str * recorder;
+ 	/// Trace of the events inserted into the output channels - NULL when not tracing (see tracer.h)
+ 	struct tracer_str * tracer;
+ 	/// Lookahead mode: output channels are marked to be simulated until the next timestamp the clock may act instead of the current time (see localClock_setLookahead())
+ 	bool lookahead;
  	/// Require exit of this simulator thread
  	volatile bool exit;
+ 	/// Threaded mode: the clock is simulated by its own thread in a process that hosts multiple clocks (see localClock_startThread()). Exit terminates the thread instead of the process.
+ 	bool threaded;
+ 	/// The thread simulating the clock in threaded mode. Owned by localClock_startThread() and localClock_joinThread()
+ 	void * thread;
  	char debugName[64];
 } localClock_t;
 
 
+/// Callback type that saves or restores the state of the model in optimistic mode (see localClock_setOptimistic())
+/// @param state storage of the state - stateSize bytes
+typedef void (*localClock_stateCallback_t) (struct localClock_members * lc, void * parameter, uint8_t * state);
+
+/// Main function of the thread of a clock in threaded mode
+/// @param parameter user defined parameter object
+typedef void (*localClock_threadMain_t) (struct localClock_members * lc, void * parameter);
+
 /// Initialize the clock structure
 /// @param initialGlobalTime the global timestamp when this objects connects the simulation - may be different than 0
 /// @param multiplierToLocal speed of clock compared to the global clock - global time is multiplied with this and >>32 to get local time (1.0 is encoded as 2^32).
@@ -133,8 +188,8 @@ uint64_t localClock_get_ms(localClock_t * lc);
 uint64_t localClock_get_us(localClock_t * lc);
 uint64_t localClock_us_to_ticks(localClock_t * lc, uint64_t us);
 uint64_t localClock_ticks_to_us(localClock_t * lc, uint64_t ticks);
-/// Setup timer
-/// @param timerIndex identify timer to be used
+/// Setup timer. O(log n) in the number of enabled timers.
+/// @param timerIndex identify timer to be used - the timer storage grows when the index is beyond its current size
 /// @param enabled enable/disable timer
 /// @param timeoutAt measured in local time
 /// @param period measured in local time ticks. 0 means no periodic execution and timer is set to disabled before first activated
@@ -149,18 +204,57 @@ void localClock_setGlobalIsrEnabled(localClock_t * lc, bool enabled);
 void localClock_setIsrEnabled(localClock_t * lc, uint32_t isrIndex, bool active);
 /// Activate/deactivate ISR by index. Active and enabled ISR will result in handler being called.
 void localClock_setIsrActive(localClock_t * lc, uint32_t isrIndex, bool active);
-/// Allocate one of the timers
+/// Allocate one of the timers. The timer storage grows when all timers are allocated.
 uint32_t localClock_allocateTimer(localClock_t * lc);
-/// Allocate one of the timers
+/// Release a timer allocated by localClock_allocateTimer()
 void localClock_releaseTimer(localClock_t * lc, uint32_t timerIndex);
+/// Release the memory allocated by the clock (timer storage and channel registrations). The clock can be created again after this call.
+void localClock_destroy(localClock_t * lc);
 /// Register an output channel with the local clock object. The simulation of the channel is marked to advance in time whenever the clock time is advancing.
 void localClock_registerChannel(localClock_t * lc, struct channelObject_str * channel);
 /// Register an input channel to be flushed when time is advancing so that the ringbuffer will not overflow and block the writing thread.
 void localClock_registerSinkToFlush(localClock_t * lc, struct channelObjectSink_str * sink);
 /// Register an input channel to be listened when time is advancing so that time may not be advanced until the source reaches simulation time.
 void localClock_registerSinkToSimulate(localClock_t * lc, struct channelObjectSink_str * sink);
+/// Enable lookahead mode: when time is advanced the output channels are marked to be simulated until the horizon of the clock instead of the current time.
+/// The horizon is the earliest of the target time of the advance, the next armed timer and the next possible event of the input channels
+/// - both the simulated and the flushed inputs, so a flushed input whose source lags behind limits the horizon to its simulatedUntil.
+/// Readers of the outputs can advance their simulation further without waiting for each step of this clock.
+/// Only valid when the clock only acts (inserts events into the outputs) from timer, ISR and input event callbacks and from the code that advances time
+/// - ISRs must not be activated by other threads.
+void localClock_setLookahead(localClock_t * lc, bool enabled);
+/// Allocate the ringbuffers of the registered input sinks on the NUMA node (see channelObjectSink_bindToNode()). Broadcast sinks are skipped.
+/// Called after the sinks are registered - e.g. localClock_bindInputsToNode(lc, sharedMemory_currentNode()) by the thread of the clock.
+/// @return false when the NUMA policy of any ringbuffer could not be set
+bool localClock_bindInputsToNode(localClock_t * lc, int node);
+/// Attach the clock to a GVT coordinator (see timeCoordinator.h). While the clock waits for an input it publishes its state to the coordinator
+/// and when all attached clocks are idle the outputs are marked simulated until the global minimum of their next actions.
+/// Same conditions apply as in lookahead mode (see localClock_setLookahead()). Must be called before the simulation is started.
+/// @param coordinator shared by all clocks of the simulation - all clocks that send events to this clock must be attached to it
+void localClock_setCoordinator(localClock_t * lc, struct timeCoordinator_str * coordinator);
+/// Enable optimistic mode: the clock does not wait for the simulation of its inputs but advances speculatively and rolls back when an input event
+/// arrives for a timestamp already simulated (see timeWarp.h). Events inserted into the output channels are sent speculatively and cancelled by a rollback:
+/// optimistic readers process them ahead, conservative readers only when they can not be rolled back any more. The output channels must be registered by localClock_registerChannel().
+/// localClock_waitUntilGlobal() returns when the simulation is final until the target time, so the code calling it is never rolled back.
+/// The state of the model changed by the timer, ISR and input event callbacks must be saved and restored by the callbacks.
+/// channelObject_reserveEvent() can not be used on the outputs and the batch callbacks of the inputs are not called in this mode.
+/// @param maxSnapshots maximum number of speculative steps ahead of the inputs - the clock waits for its inputs when all are used
+/// @param stateSize size of the model state in bytes saved by the save callback
+/// @param save saves the model state before each speculative step - may be NULL
+/// @param restore restores the model state on rollback - may be NULL
+void localClock_setOptimistic(localClock_t * lc, uint32_t maxSnapshots, uint32_t stateSize, localClock_stateCallback_t save, localClock_stateCallback_t restore, void * parameter);
 /// Check if exit was called on this clock. Used in busy wait loops to exit the process when the simulation should stop gracefully.
+/// In threaded mode only the current thread exits - also when exit is requested on the clock of the current thread not on lc.
 void localClock_checkExit(localClock_t * lc);
+/// Request the simulation of the clock to stop gracefully. The simulator of the clock exits when it waits for an other simulator next time.
+void localClock_requestExit(localClock_t * lc);
+/// Threaded mode: start the simulation of the clock in a new thread of this process. Several clocks can be simulated in a single process this way
+/// and the channels between them can be stored in process local memory (see sharedMemory_allocatePrivate()).
+/// @param threadMain the simulation of the clock - executed in the new thread
+/// @param parameter passed to threadMain - not accessed by the clock itself and may be NULL
+void localClock_startThread(localClock_t * lc, localClock_threadMain_t threadMain, void * parameter);
+/// Threaded mode: wait until the thread of the clock finishes (threadMain returned or exit was requested).
+void localClock_joinThread(localClock_t * lc);
 
 #include "channelObject.h"
 
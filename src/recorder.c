@@ -0,0 +1,291 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "recorder.h"
+#include "assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/// Identifies the recording files
+#define RECORDER_MAGIC 0x43455253u
+#define RECORDER_VERSION 2
+/// Size of the stdio buffer of the file - records are written without a system call in most cases
+#define RECORDER_FILE_BUFFER_SIZE (1<<20)
+
+/// Record types. Each record starts with its type byte.
+/// Channel: uint16 index, uint32 message size, uint8 variable length, debug name of MAX_CHANNEL_NAME_LENGTH+1 bytes
+#define RECORDER_RECORD_CHANNEL 1
+/// Event: uint16 channel index, uint64 timestamp, uint32 size, payload
+#define RECORDER_RECORD_EVENT 2
+/// Step: uint64 timestamp the clock advanced to
+#define RECORDER_RECORD_STEP 3
+
+/// Wraps the callback of the recorded sinks
+static void recorder_eventCallback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size);
+/// Events of a channel with the same timestamp - inserted together so the timestamp is not increased by the insert of each event
+typedef struct
+{
+  uint32_t channel;
+  uint64_t timestamp;
+  uint32_t nEvents;
+  uint32_t maxEvents;
+  /// Payload of the events after each other
+  uint8_t * data;
+  uint64_t dataSize;
+  uint64_t dataCapacity;
+  uint32_t * sizes;
+  uint64_t * offsets;
+  const uint8_t ** events;
+} replay_group_t;
+
+/// Main function of the replay thread
+static void * replay_threadMain(void * parameter);
+/// Add an event to the group
+static void replay_groupAdd(replay_group_t * group, uint32_t size);
+/// Insert the events of the group into the replayed channel and empty the group
+static void replay_groupFlush(replay_t * rep, replay_group_t * group);
+/// Read from the recording. Returns false at the end of the file.
+static bool replay_read(replay_t * rep, void * data, size_t size);
+
+recorder_t * recorder_open(localClock_t * lc, const char * path)
+{
+  assert(lc->recorder==NULL && lc->timeWarp==NULL);
+  recorder_t * rec=malloc(sizeof(recorder_t));
+  assert(rec!=NULL);
+  rec->file=fopen(path, "wb");
+  assertErrno(rec->file!=NULL);
+  setvbuf(rec->file, NULL, _IOFBF, RECORDER_FILE_BUFFER_SIZE);
+  rec->nSinks=0;
+  rec->lastStep=lc->globalTime;
+  uint32_t header[2]={RECORDER_MAGIC, RECORDER_VERSION};
+  assertErrno(fwrite(header, sizeof(header), 1, rec->file)==1);
+  lc->recorder=rec;
+  return rec;
+}
+
+void recorder_attachSink(recorder_t * rec, channelObjectSink_t * sink)
+{
+  assert(rec->nSinks<RECORDER_MAX_CHANNELS);
+  assert(sink->batchCallback==NULL);
+  recorder_sink_t * recorded=&(rec->sinks[rec->nSinks]);
+  recorded->recorder=rec;
+  recorded->index=rec->nSinks;
+  recorded->callback=sink->callback;
+  recorded->parameter=sink->parameter;
+  sink->parameter=recorded;
+  sink->callback=recorder_eventCallback;
+  rec->nSinks++;
+  channelObject_t * co=channelObjectSink_getHost(sink);
+  uint8_t type=RECORDER_RECORD_CHANNEL;
+  uint8_t variableLength=co->variableLength;
+  assertErrno(fwrite(&type, sizeof(type), 1, rec->file)==1);
+  assertErrno(fwrite(&(recorded->index), sizeof(recorded->index), 1, rec->file)==1);
+  assertErrno(fwrite(&(co->messageSize), sizeof(co->messageSize), 1, rec->file)==1);
+  assertErrno(fwrite(&variableLength, sizeof(variableLength), 1, rec->file)==1);
+  assertErrno(fwrite(co->debugName, sizeof(co->debugName), 1, rec->file)==1);
+}
+
+static void recorder_eventCallback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  recorder_sink_t * recorded=parameter;
+  FILE * file=recorded->recorder->file;
+  uint8_t type=RECORDER_RECORD_EVENT;
+  assertErrno(fwrite(&type, sizeof(type), 1, file)==1);
+  assertErrno(fwrite(&(recorded->index), sizeof(recorded->index), 1, file)==1);
+  assertErrno(fwrite(&globalTimestamp, sizeof(globalTimestamp), 1, file)==1);
+  assertErrno(fwrite(&size, sizeof(size), 1, file)==1);
+  assertErrno(fwrite(data, 1, size, file)==size);
+  if(recorded->callback!=NULL)
+  {
+    recorded->callback(recorded->parameter, globalTimestamp, sink, data, size);
+  }
+}
+
+void recorder_step(recorder_t * rec, uint64_t timestamp)
+{
+  if(timestamp>rec->lastStep)
+  {
+    uint8_t type=RECORDER_RECORD_STEP;
+    assertErrno(fwrite(&type, sizeof(type), 1, rec->file)==1);
+    assertErrno(fwrite(&timestamp, sizeof(timestamp), 1, rec->file)==1);
+    rec->lastStep=timestamp;
+  }
+}
+
+void recorder_close(localClock_t * lc)
+{
+  recorder_t * rec=lc->recorder;
+  assert(rec!=NULL);
+  assertErrno(fclose(rec->file)==0);
+  free(rec);
+  lc->recorder=NULL;
+}
+
+replay_t * replay_open(const char * path)
+{
+  replay_t * rep=malloc(sizeof(replay_t));
+  assert(rep!=NULL);
+  rep->file=fopen(path, "rb");
+  assertErrno(rep->file!=NULL);
+  setvbuf(rep->file, NULL, _IOFBF, RECORDER_FILE_BUFFER_SIZE);
+  rep->nChannels=0;
+  rep->thread=NULL;
+  uint32_t header[2];
+  assertMsg(replay_read(rep, header, sizeof(header)) && header[0]==RECORDER_MAGIC && header[1]==RECORDER_VERSION, "Not a recording file");
+  return rep;
+}
+
+void replay_attachChannel(replay_t * rep, channelObject_t * co)
+{
+  assert(rep->nChannels<RECORDER_MAX_CHANNELS);
+  rep->channels[rep->nChannels]=co;
+  rep->nChannels++;
+}
+
+static bool replay_read(replay_t * rep, void * data, size_t size)
+{
+  return size==0 || fread(data, size, 1, rep->file)==1;
+}
+
+static void replay_groupAdd(replay_group_t * group, uint32_t size)
+{
+  if(group->nEvents==group->maxEvents)
+  {
+    group->maxEvents=group->maxEvents==0?16:2*group->maxEvents;
+    group->sizes=realloc(group->sizes, group->maxEvents*sizeof(uint32_t));
+    group->offsets=realloc(group->offsets, group->maxEvents*sizeof(uint64_t));
+    group->events=realloc(group->events, group->maxEvents*sizeof(uint8_t *));
+    assert(group->sizes!=NULL && group->offsets!=NULL && group->events!=NULL);
+  }
+  if(group->dataSize+size>group->dataCapacity)
+  {
+    group->dataCapacity=group->dataSize+size>2*group->dataCapacity?group->dataSize+size:2*group->dataCapacity;
+    group->data=realloc(group->data, group->dataCapacity);
+    assert(group->data!=NULL);
+  }
+  group->sizes[group->nEvents]=size;
+  group->offsets[group->nEvents]=group->dataSize;
+  group->dataSize+=size;
+  group->nEvents++;
+}
+
+static void replay_groupFlush(replay_t * rep, replay_group_t * group)
+{
+  if(group->nEvents>0)
+  {
+    for(uint32_t i=0;i<group->nEvents;++i)
+    {
+      group->events[i]=group->data+group->offsets[i];
+    }
+    // A single insert of the group - the events recorded with the same timestamp are replayed with the same timestamp (see channelObject_insertEvents())
+    uint64_t timestamp=channelObject_insertEvents(rep->channels[group->channel], group->timestamp, group->nEvents, group->events, group->sizes, true);
+    assertMsg(timestamp==group->timestamp, "Replay of channel %s is not at the recorded timestamp", rep->channels[group->channel]->debugName);
+    group->nEvents=0;
+    group->dataSize=0;
+  }
+}
+
+static void * replay_threadMain(void * parameter)
+{
+  replay_t * rep=parameter;
+  uint8_t type;
+  replay_group_t group;
+  memset(&group, 0, sizeof(group));
+  while(replay_read(rep, &type, sizeof(type)))
+  {
+    if(type!=RECORDER_RECORD_EVENT)
+    {
+      replay_groupFlush(rep, &group);
+    }
+    if(type==RECORDER_RECORD_CHANNEL)
+    {
+      uint16_t index;
+      uint32_t messageSize;
+      uint8_t variableLength;
+      char debugName[MAX_CHANNEL_NAME_LENGTH+1];
+      assert(replay_read(rep, &index, sizeof(index)) && replay_read(rep, &messageSize, sizeof(messageSize))
+          && replay_read(rep, &variableLength, sizeof(variableLength)) && replay_read(rep, debugName, sizeof(debugName)));
+      assertMsg(index<rep->nChannels, "Recorded channel %s is not attached to the replay", debugName);
+      channelObject_t * co=rep->channels[index];
+      assertMsg(co->messageSize==messageSize && co->variableLength==(variableLength!=0), "Replay channel differs from recorded channel %s", debugName);
+    }else if(type==RECORDER_RECORD_EVENT)
+    {
+      uint16_t index;
+      uint64_t timestamp;
+      uint32_t size;
+      assert(replay_read(rep, &index, sizeof(index)) && replay_read(rep, &timestamp, sizeof(timestamp)) && replay_read(rep, &size, sizeof(size)));
+      assert(index<rep->nChannels && size<=rep->channels[index]->messageSize);
+      // Events of a channel with the same timestamp were inserted together and are delivered one after the other
+      if(group.nEvents>0 && (group.channel!=index || group.timestamp!=timestamp))
+      {
+        replay_groupFlush(rep, &group);
+      }
+      group.channel=index;
+      group.timestamp=timestamp;
+      replay_groupAdd(&group, size);
+      assert(replay_read(rep, group.data+group.offsets[group.nEvents-1], size));
+    }else
+    {
+      assertMsg(type==RECORDER_RECORD_STEP, "Invalid record type %u in recording", type);
+      uint64_t timestamp;
+      assert(replay_read(rep, &timestamp, sizeof(timestamp)));
+      // All events until the step were delivered before the step record
+      for(uint32_t i=0;i<rep->nChannels;++i)
+      {
+        channelObject_promiseNoEventBefore(rep->channels[i], timestamp+1);
+      }
+    }
+  }
+  replay_groupFlush(rep, &group);
+  for(uint32_t i=0;i<rep->nChannels;++i)
+  {
+    channelObject_promiseNoEventBefore(rep->channels[i], UINT64_MAX);
+  }
+  free(group.data);
+  free(group.sizes);
+  free(group.offsets);
+  free(group.events);
+  return NULL;
+}
+
+void replay_start(replay_t * rep)
+{
+  assert(rep->thread==NULL);
+  pthread_t * thread=malloc(sizeof(pthread_t));
+  assert(thread!=NULL);
+  assert(pthread_create(thread, NULL, replay_threadMain, rep)==0);
+  rep->thread=thread;
+}
+
+void replay_close(replay_t * rep)
+{
+  if(rep->thread!=NULL)
+  {
+    assert(pthread_join(*(pthread_t *)rep->thread, NULL)==0);
+    free(rep->thread);
+  }
+  assertErrno(fclose(rep->file)==0);
+  free(rep);
+}
@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_RECORDER_H_
+#define SIMULATOR_RECORDER_H_
+
+/// Record and replay of the input traffic of a single clock.
+///
+/// Recording: every event delivered to the recorded sinks of the clock is written into a binary file with its channel, timestamp and payload,
+/// and after each step of the clock the time the clock advanced to is written. The time of the step is the progression of the inputs: the inputs
+/// were simulated at least until this time so no event of a later step is earlier.
+///
+/// Replay: the clock is set up with the same sinks but the channels are sourced by a replay thread of the same process instead of the peer
+/// processes. The thread inserts the recorded events and marks the channels simulated until each recorded step so the clock runs at full speed
+/// and processes the same events at the same timestamps without the rest of the simulation. Events of a channel recorded with the same timestamp
+/// (see channelObject_insertEvents()) are inserted again with a single insert so their timestamp is not increased.
+
+#include "channelObject.h"
+#include <stdio.h>
+
+/// Maximum number of channels recorded by a recorder
+#define RECORDER_MAX_CHANNELS 64
+
+/// A recorded sink: the original callback is called after the event is recorded
+typedef struct
+{
+  struct recorder_str * recorder;
+  uint16_t index;
+  channelObjectEventCallback_t callback;
+  void * parameter;
+} recorder_sink_t;
+
+/// Recorder of the inputs of a clock - process local memory
+typedef struct recorder_str
+{
+  FILE * file;
+  recorder_sink_t sinks[RECORDER_MAX_CHANNELS];
+  uint32_t nSinks;
+  /// Time of the last step written into the file
+  uint64_t lastStep;
+} recorder_t;
+
+/// Replay of a recording - process local memory
+typedef struct replay_str
+{
+  FILE * file;
+  /// Channels fed by the replay in the order of recorder_attachSink() calls of the recording
+  channelObject_t * channels[RECORDER_MAX_CHANNELS];
+  uint32_t nChannels;
+  /// The replay thread
+  void * thread;
+} replay_t;
+
+/// Start recording the inputs of the clock into a file. Not supported in optimistic mode.
+recorder_t * recorder_open(localClock_t * lc, const char * path);
+/// Record the events delivered to the sink. Must be called after channelObjectSink_setEnabled() - the callback of the sink is wrapped by the recorder.
+/// The batch callback of the sink is not supported.
+void recorder_attachSink(recorder_t * rec, channelObjectSink_t * sink);
+/// Write the time the clock advanced to - called by the clock after each step
+void recorder_step(recorder_t * rec, uint64_t timestamp);
+/// Finish the recording and close the file
+void recorder_close(localClock_t * lc);
+
+/// Open a recording to replay
+replay_t * replay_open(const char * path);
+/// Set the channel that replays the next recorded channel. The channel must be configured the same way as the recorded one (message size, variable length)
+/// and must not be sourced by any clock - the replay thread inserts the events. Its sink is registered with the replayed clock the same way as on the recording.
+void replay_attachChannel(replay_t * rep, channelObject_t * co);
+/// Start the replay thread. After the last record all channels are marked simulated until the end of time.
+void replay_start(replay_t * rep);
+/// Wait until the replay thread finishes and close the recording
+void replay_close(replay_t * rep);
+
+#endif /* SIMULATOR_RECORDER_H_ */
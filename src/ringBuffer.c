@@ -23,41 +23,132 @@ SOFTWARE.
  */
 
 #include "ringBuffer.h"
+#include "assert.h"
 #include <string.h>
 
+/// Number of bytes between the read and write pointer
+static inline uint32_t ringBuffer_fill(const ringBuffer_t * ringBuffer, uint32_t ptrWrite, uint32_t ptrRead)
+{
+  if(ringBuffer->mask!=0)
+  {
+    return ptrWrite-ptrRead;
+  }
+  uint32_t ret=ptrWrite+ringBuffer->bufferSize-ptrRead;
+  if(ret>=ringBuffer->bufferSize)
+  {
+    ret-=ringBuffer->bufferSize;
+  }
+  return ret;
+}
+/// Number of bytes that can be stored
+static inline uint32_t ringBuffer_capacity(const ringBuffer_t * ringBuffer)
+{
+  if(ringBuffer->mask!=0)
+  {
+    return ringBuffer->bufferSize;
+  }
+  return ringBuffer->bufferSize-1;
+}
+/// Index in the buffer array of a read or write pointer
+static inline uint32_t ringBuffer_index(const ringBuffer_t * ringBuffer, uint32_t ptr)
+{
+  if(ringBuffer->mask!=0)
+  {
+    return ptr&ringBuffer->mask;
+  }
+  return ptr;
+}
+/// Move pointer forward by nBytes with wrap around
+static inline uint32_t ringBuffer_advance(const ringBuffer_t * ringBuffer, uint32_t ptr, uint32_t nBytes)
+{
+  ptr+=nBytes;
+  if(ringBuffer->mask==0 && ptr>=ringBuffer->bufferSize)
+  {
+    ptr-=ringBuffer->bufferSize;
+  }
+  return ptr;
+}
+/// Reader side: number of bytes readable. The write pointer is only reloaded when the cached copy shows less than nBytes.
+static inline uint32_t ringBuffer_readable(ringBuffer_t * ringBuffer, uint32_t ptrRead, uint32_t nBytes)
+{
+  uint32_t ret=ringBuffer_fill(ringBuffer, ringBuffer->cachedWrite, ptrRead);
+  if(ret<nBytes)
+  {
+    ringBuffer->cachedWrite=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_acquire);
+    ret=ringBuffer_fill(ringBuffer, ringBuffer->cachedWrite, ptrRead);
+  }
+  return ret;
+}
+/// Writer side: number of bytes writable. The read pointer is only reloaded when the cached copy shows less than nBytes.
+static inline uint32_t ringBuffer_writable(ringBuffer_t * ringBuffer, uint32_t ptrWrite, uint32_t nBytes)
+{
+  uint32_t ret=ringBuffer_capacity(ringBuffer)-ringBuffer_fill(ringBuffer, ptrWrite, ringBuffer->cachedRead);
+  if(ret<nBytes)
+  {
+    ringBuffer->cachedRead=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_acquire);
+    ret=ringBuffer_capacity(ringBuffer)-ringBuffer_fill(ringBuffer, ptrWrite, ringBuffer->cachedRead);
+  }
+  return ret;
+}
+/// Copy data into the buffer from the given index. Data is split into two parts when it reaches the end of the buffer (except mirrored buffers).
+static inline void ringBuffer_copyIn(ringBuffer_t * ringBuffer, uint32_t at, uint32_t nBytes, const uint8_t * data)
+{
+  uint32_t firstSize=ringBuffer->bufferSize-at;
+  if(nBytes>firstSize && !ringBuffer->mirrored)
+  {
+    memcpy(&(ringBuffer_getBuffer(ringBuffer)[at]), data, firstSize);
+    memcpy(&(ringBuffer_getBuffer(ringBuffer)[0]), &(data[firstSize]), nBytes-firstSize);
+  }else
+  {
+    memcpy(&(ringBuffer_getBuffer(ringBuffer)[at]), data, nBytes);
+  }
+}
+/// Copy data out of the buffer from the given index. Data is split into two parts when it reaches the end of the buffer (except mirrored buffers).
+static inline void ringBuffer_copyOut(const ringBuffer_t * ringBuffer, uint32_t at, uint32_t nBytes, uint8_t * data)
+{
+  uint32_t firstSize=ringBuffer->bufferSize-at;
+  if(nBytes>firstSize && !ringBuffer->mirrored)
+  {
+    memcpy(data, &(ringBuffer_getBuffer(ringBuffer)[at]), firstSize);
+    memcpy(&(data[firstSize]), &(ringBuffer_getBuffer(ringBuffer)[0]), nBytes-firstSize);
+  }else
+  {
+    memcpy(data, &(ringBuffer_getBuffer(ringBuffer)[at]), nBytes);
+  }
+}
+
 void ringBuffer_create(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer)
 {
-	ringBuffer->ptrRead=0;
-	ringBuffer->ptrWrite=0;
+	atomic_store_explicit(&ringBuffer->ptrRead, 0, memory_order_relaxed);
+	atomic_store_explicit(&ringBuffer->ptrWrite, 0, memory_order_relaxed);
+	ringBuffer->cachedRead=0;
+	ringBuffer->cachedWrite=0;
 	ringBuffer->bufferSize=bufferSize;
-	ringBuffer->buffer=buffer;
+	ringBuffer->mask=0;
+	ringBuffer->mirrored=false;
+	relativePtr_set(ringBuffer->buffer, buffer);
+}
+
+void ringBuffer_createPowerOfTwo(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer)
+{
+  assert(bufferSize>=2 && bufferSize<=0x80000000u && (bufferSize&(bufferSize-1))==0);
+  ringBuffer_create(ringBuffer, bufferSize, buffer);
+  ringBuffer->mask=bufferSize-1;
+}
+
+void ringBuffer_createMirrored(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer)
+{
+  ringBuffer_createPowerOfTwo(ringBuffer, bufferSize, buffer);
+  ringBuffer->mirrored=true;
 }
 
 bool ringBuffer_write(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t * data)
 {
-	if(ringBuffer->buffer!=NULL && ringBuffer_availableWrite(ringBuffer)>=nBytes)
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+	if(ringBuffer->buffer!=0 && ringBuffer_writable(ringBuffer, at, nBytes)>=nBytes)
 	{
-		uint32_t at=ringBuffer->ptrWrite;
-		uint32_t newPtr=at+nBytes;
-		if(newPtr>ringBuffer->bufferSize)
-		{
-			uint32_t firstSize=ringBuffer->bufferSize-at;
-			uint32_t secondSize=nBytes-firstSize;
-			memcpy(&(ringBuffer->buffer[at]), data, firstSize);
-			at=0;
-			memcpy(&(ringBuffer->buffer[at]), &(data[firstSize]), secondSize);
-			at=secondSize;
-			ringBuffer->ptrWrite=at;
-		}else
-		{
-			memcpy(&(ringBuffer->buffer[at]), data, nBytes);
-			at+=nBytes;
-			if(at==ringBuffer->bufferSize)
-			{
-				at=0;
-			}
-			ringBuffer->ptrWrite=at;
-		}
+	  ringBuffer_copyIn(ringBuffer, ringBuffer_index(ringBuffer, at), nBytes, data);
+	  atomic_store_explicit(&ringBuffer->ptrWrite, ringBuffer_advance(ringBuffer, at, nBytes), memory_order_release);
 		return true;
 	}else
 	{
@@ -66,38 +157,14 @@ bool ringBuffer_write(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t * data
 }
 bool ringBuffer_read(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t * data)
 {
-	if(ringBuffer_availableRead(ringBuffer)>=nBytes)
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_relaxed);
+	if(ringBuffer_readable(ringBuffer, at, nBytes)>=nBytes)
 	{
-		uint32_t at=ringBuffer->ptrRead;
-		uint32_t newPtr=at+nBytes;
-		if(newPtr>ringBuffer->bufferSize)
-		{
-			uint32_t firstSize=ringBuffer->bufferSize-at;
-			uint32_t secondSize=nBytes-firstSize;
-			if(data!=NULL)
-			{
-			  memcpy(data, &(ringBuffer->buffer[at]), firstSize);
-			}
-			at=0;
-      if(data!=NULL)
-      {
-        memcpy(&(data[firstSize]), &(ringBuffer->buffer[at]), secondSize);
-      }
-			at=secondSize;
-			ringBuffer->ptrRead=at;
-		}else
-		{
-      if(data!=NULL)
-      {
-        memcpy(data, &(ringBuffer->buffer[at]), nBytes);
-      }
-			at+=nBytes;
-			if(at==ringBuffer->bufferSize)
-			{
-				at=0;
-			}
-			ringBuffer->ptrRead=at;
-		}
+    if(data!=NULL)
+    {
+      ringBuffer_copyOut(ringBuffer, ringBuffer_index(ringBuffer, at), nBytes, data);
+    }
+    atomic_store_explicit(&ringBuffer->ptrRead, ringBuffer_advance(ringBuffer, at, nBytes), memory_order_release);
 		return true;
 	}else
 	{
@@ -106,79 +173,50 @@ bool ringBuffer_read(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t * data)
 }
 bool ringBuffer_peek(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t * data)
 {
-	if(ringBuffer_availableRead(ringBuffer)>=nBytes)
-	{
-		uint32_t at=ringBuffer->ptrRead;
-		uint32_t newPtr=at+nBytes;
-		if(newPtr>ringBuffer->bufferSize)
-		{
-			uint32_t firstSize=ringBuffer->bufferSize-at;
-			uint32_t secondSize=nBytes-firstSize;
-			memcpy(data, &(ringBuffer->buffer[at]), firstSize);
-			at=0;
-			memcpy(&(data[firstSize]), &(ringBuffer->buffer[at]), secondSize);
-			at=secondSize;
-		}else
-		{
-			memcpy(data, &(ringBuffer->buffer[at]), nBytes);
-			at+=nBytes;
-			if(at==ringBuffer->ptrWrite)
-			{
-				at=0;
-			}
-		}
-		return true;
-	}else
-	{
-		return false;
-	}
+  return ringBuffer_peekOffset(ringBuffer, 0, nBytes, data);
 }
 bool ringBuffer_peekOffset(ringBuffer_t * ringBuffer, uint32_t offset, uint32_t nBytes, uint8_t * data)
 {
-  if(ringBuffer_availableRead(ringBuffer)>=nBytes+offset)
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_relaxed);
+  if(ringBuffer_readable(ringBuffer, at, nBytes+offset)>=nBytes+offset)
   {
-    uint32_t at=ringBuffer->ptrRead+offset;
-    if(at>=ringBuffer->bufferSize)
-    {
-      at-=ringBuffer->bufferSize;
-    }
-    uint32_t newPtr=at+nBytes;
-    if(newPtr>ringBuffer->bufferSize)
-    {
-      uint32_t firstSize=ringBuffer->bufferSize-at;
-      uint32_t secondSize=nBytes-firstSize;
-      memcpy(data, &(ringBuffer->buffer[at]), firstSize);
-      at=0;
-      memcpy(&(data[firstSize]), &(ringBuffer->buffer[at]), secondSize);
-      at=secondSize;
-    }else
-    {
-      memcpy(data, &(ringBuffer->buffer[at]), nBytes);
-      at+=nBytes;
-      if(at==ringBuffer->ptrWrite)
-      {
-        at=0;
-      }
-    }
+    ringBuffer_copyOut(ringBuffer, ringBuffer_index(ringBuffer, ringBuffer_advance(ringBuffer, at, offset)), nBytes, data);
     return true;
   }else
   {
     return false;
   }
 }
+uint32_t ringBuffer_accessReadSpans(ringBuffer_t * ringBuffer, uint8_t ** first, uint32_t * firstBytes, uint8_t ** second)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_relaxed);
+  uint32_t nBytes=ringBuffer_readable(ringBuffer, at, UINT32_MAX);
+  at=ringBuffer_index(ringBuffer, at);
+  *first=&(ringBuffer_getBuffer(ringBuffer)[at]);
+  *second=&(ringBuffer_getBuffer(ringBuffer)[0]);
+  if(at+nBytes>ringBuffer->bufferSize && !ringBuffer->mirrored)
+  {
+    *firstBytes=ringBuffer->bufferSize-at;
+  }else
+  {
+    *firstBytes=nBytes;
+  }
+  return nBytes;
+}
 uint32_t ringBuffer_accessReadBuffer(ringBuffer_t * ringBuffer, uint8_t ** ptrBuffer, uint32_t maxBytes)
 {
-  uint32_t nBytes=ringBuffer_availableRead(ringBuffer);
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_relaxed);
+  uint32_t nBytes=ringBuffer_readable(ringBuffer, at, maxBytes);
   if(nBytes>maxBytes)
   {
     nBytes=maxBytes;
   }
   if(nBytes>0)
   {
-    uint32_t at=ringBuffer->ptrRead;
-    *ptrBuffer=&(ringBuffer->buffer[at]);
+    at=ringBuffer_index(ringBuffer, at);
+    *ptrBuffer=&(ringBuffer_getBuffer(ringBuffer)[at]);
     uint32_t newPtr=at+nBytes;
-    if(newPtr>ringBuffer->bufferSize)
+    if(newPtr>ringBuffer->bufferSize && !ringBuffer->mirrored)
     {
       uint32_t firstSize=ringBuffer->bufferSize-at;
       return firstSize;
@@ -192,32 +230,113 @@ uint32_t ringBuffer_accessReadBuffer(ringBuffer_t * ringBuffer, uint8_t ** ptrBu
   }
 }
 
+uint32_t ringBuffer_reserve(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t ** ptrBuffer)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+  if(ringBuffer->buffer==0 || nBytes==0 || ringBuffer_writable(ringBuffer, at, nBytes)<nBytes)
+  {
+    return 0u;
+  }
+  at=ringBuffer_index(ringBuffer, at);
+  *ptrBuffer=&(ringBuffer_getBuffer(ringBuffer)[at]);
+  uint32_t firstSize=ringBuffer->bufferSize-at;
+  if(nBytes>firstSize && !ringBuffer->mirrored)
+  {
+    return firstSize;
+  }else
+  {
+    return nBytes;
+  }
+}
+void ringBuffer_writeReserved(ringBuffer_t * ringBuffer, uint32_t offset, uint32_t nBytes, const uint8_t * data)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+  ringBuffer_copyIn(ringBuffer, ringBuffer_index(ringBuffer, ringBuffer_advance(ringBuffer, at, offset)), nBytes, data);
+}
+void ringBuffer_commit(ringBuffer_t * ringBuffer, uint32_t nBytes)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+  atomic_store_explicit(&ringBuffer->ptrWrite, ringBuffer_advance(ringBuffer, at, nBytes), memory_order_release);
+}
+uint32_t ringBuffer_getWritePosition(ringBuffer_t * ringBuffer)
+{
+  return atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+}
+void ringBuffer_overwrite(ringBuffer_t * ringBuffer, uint32_t position, uint32_t offset, uint32_t nBytes, const uint8_t * data)
+{
+  ringBuffer_copyIn(ringBuffer, ringBuffer_index(ringBuffer, ringBuffer_advance(ringBuffer, position, offset)), nBytes, data);
+}
+
+void ringBuffer_createView(ringBuffer_t * view, ringBuffer_t * source)
+{
+  uint32_t at=atomic_load_explicit(&source->ptrWrite, memory_order_acquire);
+  view->bufferSize=source->bufferSize;
+  view->mask=source->mask;
+  view->mirrored=source->mirrored;
+  relativePtr_set(view->buffer, ringBuffer_getBuffer(source));
+  view->cachedRead=at;
+  view->cachedWrite=at;
+  atomic_store_explicit(&view->ptrRead, at, memory_order_relaxed);
+  atomic_store_explicit(&view->ptrWrite, at, memory_order_release);
+}
+void ringBuffer_publishView(ringBuffer_t * source, ringBuffer_t * view)
+{
+  uint32_t at=atomic_load_explicit(&source->ptrWrite, memory_order_relaxed);
+  atomic_store_explicit(&view->ptrWrite, at, memory_order_release);
+}
+uint32_t ringBuffer_viewUnread(ringBuffer_t * source, ringBuffer_t * view)
+{
+  uint32_t ptrWrite=atomic_load_explicit(&source->ptrWrite, memory_order_relaxed);
+  uint32_t ptrRead=atomic_load_explicit(&view->ptrRead, memory_order_acquire);
+  return ringBuffer_fill(source, ptrWrite, ptrRead);
+}
+void ringBuffer_releaseRead(ringBuffer_t * source, uint32_t nBytes)
+{
+  uint32_t at=atomic_load_explicit(&source->ptrWrite, memory_order_relaxed);
+  if(source->mask!=0)
+  {
+    at-=nBytes;
+  }else
+  {
+    at=ringBuffer_advance(source, at, source->bufferSize-nBytes);
+  }
+  atomic_store_explicit(&source->ptrRead, at, memory_order_release);
+}
 
+uint32_t ringBuffer_getCapacity(const ringBuffer_t * ringBuffer)
+{
+  return ringBuffer_capacity(ringBuffer);
+}
 uint32_t ringBuffer_availableWrite(ringBuffer_t * ringBuffer)
 {
 	uint32_t fill=ringBuffer_availableRead(ringBuffer);
-	return ringBuffer->bufferSize-1-fill;
+	return ringBuffer_capacity(ringBuffer)-fill;
 }
 
 uint32_t ringBuffer_availableRead(ringBuffer_t * ringBuffer)
 {
-	uint32_t ret=ringBuffer->ptrWrite+ringBuffer->bufferSize-ringBuffer->ptrRead;
-	if(ret>=ringBuffer->bufferSize)
-	{
-		ret-=ringBuffer->bufferSize;
-	}
-	return ret;
+  uint32_t ptrWrite=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_acquire);
+  uint32_t ptrRead=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_acquire);
+	return ringBuffer_fill(ringBuffer, ptrWrite, ptrRead);
+}
+
+bool ringBuffer_canWrite(ringBuffer_t * ringBuffer, uint32_t nBytes)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrWrite, memory_order_relaxed);
+  return ringBuffer_writable(ringBuffer, at, nBytes)>=nBytes;
+}
+
+bool ringBuffer_canRead(ringBuffer_t * ringBuffer, uint32_t nBytes)
+{
+  uint32_t at=atomic_load_explicit(&ringBuffer->ptrRead, memory_order_relaxed);
+  return ringBuffer_readable(ringBuffer, at, nBytes)>=nBytes;
 }
 
 void ringBuffer_clear(ringBuffer_t * ringBuffer)
 {
-  ringBuffer->buffer=NULL;
-  ringBuffer->bufferSize=0;
-  ringBuffer->ptrRead=0;
-  ringBuffer->ptrWrite=0;
+  ringBuffer_create(ringBuffer, 0, NULL);
 }
 bool ringBuffer_isCreated(ringBuffer_t * ringBuffer)
 {
-  return ringBuffer->buffer!=NULL;
+  return ringBuffer->buffer!=0;
 }
-
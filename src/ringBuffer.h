@@ -22,27 +22,65 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 #ifndef SIMULATOR_RINGBUFFER_H
-#define SIMULATOR_RINGBUFFER_ H
+#define SIMULATOR_RINGBUFFER_H
 
 /// ringbuffer implementation used by the simulator to store channel events
+/// The ringbuffer is lock free single producer - single consumer: one thread (process) may write and one other thread (process) may read it.
+/// The read and write pointers are published using C11 acquire/release atomics. Both sides keep a local copy of the pointer of the other side
+/// and only reload it when the copy shows that the ringbuffer is full (writer) or empty (reader). This way the cache line of the other side
+/// is not pulled on every operation.
+/// Two variants exist: ringBuffer_create() accepts any size and can store bufferSize-1 bytes. ringBuffer_createPowerOfTwo() requires a
+/// power of two size, uses free running pointers and mask based indexing and can store bufferSize bytes.
+/// ringBuffer_createMirrored() is a power of two ringbuffer whose buffer is mapped twice back to back in the virtual memory
+/// (see sharedMemory_allocateMirrored()). Data is then always continuous - no copy has to be split at the end of the buffer.
 
 #include "simulator_types.h"
+#include <stdatomic.h>
 
 /// Structure to store fields of a ringbuffer object.
 typedef struct
 {
-	//! ptrRead==ptrWrite means empty
-  volatile uint32_t ptrRead;
-	volatile uint32_t ptrWrite;
-	uint32_t bufferSize;
-	uint8_t * buffer;
+  /// Reader side - written only by the reader.
+	//! ptrRead==ptrWrite means empty. In power of two mode the pointers are free running and the index is ptr&mask
+  _Alignas(SIMULATOR_CACHE_LINE_SIZE) _Atomic uint32_t ptrRead;
+  /// Last value of ptrWrite seen by the reader.
+  uint32_t cachedWrite;
+  /// Writer side - written only by the writer.
+  _Alignas(SIMULATOR_CACHE_LINE_SIZE) _Atomic uint32_t ptrWrite;
+  /// Last value of ptrRead seen by the writer.
+  uint32_t cachedRead;
+  /// Configuration - not changed after create.
+  _Alignas(SIMULATOR_CACHE_LINE_SIZE) uint32_t bufferSize;
+  /// bufferSize-1 in power of two mode. 0 means the classic mode with wrapping pointers.
+  uint32_t mask;
+  /// The buffer is followed by a second mapping of the same memory pages. Any bufferSize bytes starting inside the buffer are continuous.
+  bool mirrored;
+	/// The storage of the data - relative to the field so the ringbuffer works in shared memory mapped at any address. See ringBuffer_getBuffer()
+	relativePtr_t buffer;
 } ringBuffer_t;
 
+/// The storage of the data of the ringbuffer
+static inline uint8_t * ringBuffer_getBuffer(const ringBuffer_t * ringBuffer)
+{
+  return relativePtr_get(ringBuffer->buffer, uint8_t);
+}
+
 /// Initialize the given structure with initial values: empty ringbuffer
 /// @param ringBuffer user provided static storage of the ringbuffer object
 /// @param bufferSize size of the buffer used to store data (bufferSize-1 bytes can be used due to implementation details)
 /// @param buffer static allocated buffer to store actual data
 void ringBuffer_create(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer);
+/// Initialize the given structure as an empty power of two ringbuffer.
+/// Wrap around is handled by masking the free running pointers and the whole buffer can be used to store data.
+/// @param bufferSize size of the buffer - must be a power of two and at least 2
+/// @param buffer static allocated buffer to store actual data
+void ringBuffer_createPowerOfTwo(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer);
+/// Initialize the given structure as an empty power of two ringbuffer over a double mapped buffer.
+/// ringBuffer_accessReadBuffer() and ringBuffer_reserve() always return the full requested size.
+/// @param bufferSize size of the buffer - must be a power of two and multiple of the page size
+/// @param buffer buffer of 2*bufferSize virtual bytes where the second half maps the same memory as the first half.
+///   See sharedMemory_allocateMirrored() and sharedMemory_mirrorRange()
+void ringBuffer_createMirrored(ringBuffer_t * ringBuffer, uint32_t bufferSize, uint8_t * buffer);
 
 /// Set buffer pointer to NULL - ringbuffer is in not usabe state - this is not standard feature of ringbuffer implementations
 void ringBuffer_clear(ringBuffer_t * ringBuffer);
@@ -68,10 +106,55 @@ bool ringBuffer_peekOffset(ringBuffer_t * ringBuffer, uint32_t offset, uint32_t
 /// @param maxBytes the maximum number of bytes to be processed in a single transaction
 /// @return number of bytes accessible by the pointer. Can be less than all bytes available because when read pointer is reset to 0 then the data is only accessible in two continuous parts
 uint32_t ringBuffer_accessReadBuffer(ringBuffer_t * ringBuffer, uint8_t ** ptrBuffer, uint32_t maxBytes);
+/// Access all data in the read part of the ringbuffer as two continuous spans. The second span starts at the beginning of the buffer and is empty unless the data wraps around the end of the buffer.
+/// @param[out] first set to the current read position
+/// @param[out] firstBytes set to the number of bytes in the first span
+/// @param[out] second set to the start of the second span
+/// @return number of bytes in the two spans together
+uint32_t ringBuffer_accessReadSpans(ringBuffer_t * ringBuffer, uint8_t ** first, uint32_t * firstBytes, uint8_t ** second);
+/// Reserve space in the write part of the ringbuffer. Useful to implement no copy write into the ringbuffer.
+/// The reserved data is not visible to the reader until ringBuffer_commit() is called. Must only be called by the writer.
+/// @param nBytes number of bytes to reserve
+/// @param[out] ptrBuffer Will be set to the current write position
+/// @return number of bytes accessible by the pointer. 0 means there is not enough space for nBytes. Can be less than nBytes because the reserved space may wrap around the end of the buffer - the rest starts at the beginning of the buffer
+uint32_t ringBuffer_reserve(ringBuffer_t * ringBuffer, uint32_t nBytes, uint8_t ** ptrBuffer);
+/// Copy data into the reserved (not yet committed) part of the ringbuffer. Wrap around is handled.
+/// @param offset position relative to the current write pointer
+void ringBuffer_writeReserved(ringBuffer_t * ringBuffer, uint32_t offset, uint32_t nBytes, const uint8_t * data);
+/// Publish nBytes of the reserved space to the reader by moving the write pointer.
+void ringBuffer_commit(ringBuffer_t * ringBuffer, uint32_t nBytes);
+/// Writer side: the current write pointer - the position of the next byte committed. Used to find committed data again by ringBuffer_overwrite().
+uint32_t ringBuffer_getWritePosition(ringBuffer_t * ringBuffer);
+/// Writer side: change data that is already committed but not yet read. The reader may read the data at the same time so it sees either the old or the new bytes.
+/// @param position write position returned by ringBuffer_getWritePosition() before the data was committed
+/// @param offset position of the data relative to position
+void ringBuffer_overwrite(ringBuffer_t * ringBuffer, uint32_t position, uint32_t offset, uint32_t nBytes, const uint8_t * data);
+/// Multiple readers: the writer writes a source ringbuffer and publishes its write pointer to reader views of the source.
+/// Each view has its own read pointer and shares the buffer of the source. The writer limits the space of the source to the slowest view
+/// using ringBuffer_viewUnread() and ringBuffer_releaseRead().
+
+/// Initialize (or reset) a reader view of the source ringbuffer. The view uses the buffer of the source and starts empty at the current write pointer of the source.
+void ringBuffer_createView(ringBuffer_t * view, ringBuffer_t * source);
+/// Writer side: make the data committed into the source visible to the view.
+void ringBuffer_publishView(ringBuffer_t * source, ringBuffer_t * view);
+/// Writer side: number of bytes committed into the source that are not yet read from the view.
+uint32_t ringBuffer_viewUnread(ringBuffer_t * source, ringBuffer_t * view);
+/// Writer side: move the read pointer of the source so that only the last nBytes committed are unread. Frees the space already read by all views.
+void ringBuffer_releaseRead(ringBuffer_t * source, uint32_t nBytes);
+/// Number of bytes the ringbuffer can store when it is empty
+uint32_t ringBuffer_getCapacity(const ringBuffer_t * ringBuffer);
 /// Get the number of available bytes to write
+/// Always loads the read pointer of the reader side. Writers should prefer ringBuffer_canWrite() in loops.
 uint32_t ringBuffer_availableWrite(ringBuffer_t * ringBuffer);
 /// Get the number of available bytes to read
+/// Always loads the write pointer of the writer side. Readers should prefer ringBuffer_canRead() in loops.
 uint32_t ringBuffer_availableRead(ringBuffer_t * ringBuffer);
+/// Check whether nBytes can be written. Must only be called by the writer.
+/// Cheaper than ringBuffer_availableWrite() because the read pointer is only reloaded when the cached value shows not enough space.
+bool ringBuffer_canWrite(ringBuffer_t * ringBuffer, uint32_t nBytes);
+/// Check whether nBytes can be read. Must only be called by the reader.
+/// Cheaper than ringBuffer_availableRead() because the write pointer is only reloaded when the cached value shows not enough data.
+bool ringBuffer_canRead(ringBuffer_t * ringBuffer, uint32_t nBytes);
 
 #endif
 
@@ -0,0 +1,109 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "sharedArena.h"
+#include "assert.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define TIMEOUT_MILLIS 10000
+
+sharedArena_t * sharedArena_create(void * region, uint64_t regionSize)
+{
+  assert(regionSize>=sizeof(sharedArena_t));
+  sharedArena_t * arena=region;
+  atomic_store_explicit(&(arena->ready), 0, memory_order_relaxed);
+  arena->nEntries=0;
+  arena->regionSize=regionSize;
+  arena->used=sizeof(sharedArena_t);
+  return arena;
+}
+
+void * sharedArena_allocateAligned(sharedArena_t * arena, uint64_t sizeBytes, uint64_t alignment)
+{
+  assert(alignment>0 && (alignment&(alignment-1))==0);
+  uint64_t offset=(arena->used+alignment-1)&~(alignment-1);
+  assertMsg(offset<=arena->regionSize && sizeBytes<=arena->regionSize-offset, "Shared memory region of %lu bytes is full", (unsigned long)arena->regionSize);
+  arena->used=offset+sizeBytes;
+  uint8_t * object=((uint8_t *)arena)+offset;
+  // The region may be reused (e.g. a restored shared memory object) so it is not known to be zero
+  memset(object, 0, sizeBytes);
+  return object;
+}
+
+void * sharedArena_allocate(sharedArena_t * arena, uint64_t sizeBytes)
+{
+  return sharedArena_allocateAligned(arena, sizeBytes, SIMULATOR_CACHE_LINE_SIZE);
+}
+
+void * sharedArena_allocateNamed(sharedArena_t * arena, const char * name, uint64_t sizeBytes)
+{
+  assert(strlen(name)<=SHARED_ARENA_NAME_LENGTH);
+  assertMsg(sharedArena_find(arena, name)==NULL, "Object %s is already allocated", name);
+  assertMsg(arena->nEntries<SHARED_ARENA_MAX_NAMES, "Directory of the shared memory region is full");
+  void * object=sharedArena_allocate(arena, sizeBytes);
+  sharedArena_entry_t * entry=&(arena->directory[arena->nEntries]);
+  strcpy(entry->name, name);
+  entry->offset=sharedArena_offsetOf(arena, object);
+  entry->sizeBytes=sizeBytes;
+  arena->nEntries++;
+  return object;
+}
+
+void sharedArena_publish(sharedArena_t * arena)
+{
+  atomic_store_explicit(&(arena->ready), 1, memory_order_release);
+}
+
+sharedArena_t * sharedArena_attach(void * region)
+{
+  sharedArena_t * arena=region;
+  int ctr=0;
+  while(atomic_load_explicit(&(arena->ready), memory_order_acquire)==0)
+  {
+    ctr++;
+    assertMsg(ctr<=TIMEOUT_MILLIS, "Shared memory region was not published by the master");
+    usleep(1000);
+  }
+  return arena;
+}
+
+void * sharedArena_find(sharedArena_t * arena, const char * name)
+{
+  for(uint32_t i=0;i<arena->nEntries;++i)
+  {
+    if(strcmp(arena->directory[i].name, name)==0)
+    {
+      return ((uint8_t *)arena)+arena->directory[i].offset;
+    }
+  }
+  return NULL;
+}
+
+uint64_t sharedArena_offsetOf(sharedArena_t * arena, const void * object)
+{
+  uint64_t offset=((const uint8_t *)object)-((const uint8_t *)arena);
+  assert(offset<arena->regionSize);
+  return offset;
+}
@@ -0,0 +1,86 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_SHAREDARENA_H_
+#define SIMULATOR_SHAREDARENA_H_
+
+/// Arena allocator of the simulator objects in a shared memory region (see sharedMemory_open()).
+///
+/// The arena header is placed at the start of the region. The master process allocates the channels, sink buffers and read buffers during the setup
+/// with bump allocation - objects used together can be placed next to each other. Named objects are registered in a directory stored in the region
+/// so the other processes look them up by name instead of using fixed offsets. The master publishes the arena when the setup is complete and the
+/// other processes wait for it in sharedArena_attach().
+/// Objects are never freed - the whole region is released with the shared memory.
+
+#include "simulator_types.h"
+#include <stdatomic.h>
+
+/// Maximum number of named objects in the directory
+#define SHARED_ARENA_MAX_NAMES 256
+/// Maximum length of the name of an object
+#define SHARED_ARENA_NAME_LENGTH 63
+
+/// Named object of the directory
+typedef struct
+{
+  char name[SHARED_ARENA_NAME_LENGTH+1];
+  /// Offset of the object from the start of the region
+  uint64_t offset;
+  uint64_t sizeBytes;
+} sharedArena_entry_t;
+
+/// Header of the arena at the start of the region - shared memory
+typedef struct sharedArena_str
+{
+  /// Set when the master published the arena
+  _Atomic uint32_t ready;
+  uint32_t nEntries;
+  /// Size of the region in bytes
+  uint64_t regionSize;
+  /// Offset of the first free byte of the region
+  uint64_t used;
+  sharedArena_entry_t directory[SHARED_ARENA_MAX_NAMES];
+} sharedArena_t;
+
+/// Master process: create an empty arena in the region
+/// @param region pointer returned by sharedMemory_open() or sharedMemory_allocatePrivate()
+/// @param regionSize size of the region in bytes
+sharedArena_t * sharedArena_create(void * region, uint64_t regionSize);
+/// Allocate a zero filled object aligned to SIMULATOR_CACHE_LINE_SIZE. Fails with assert when the region is full.
+void * sharedArena_allocate(sharedArena_t * arena, uint64_t sizeBytes);
+/// Allocate a zero filled object with the given alignment - e.g. the page size for the buffers of sharedMemory_mirrorRange()
+/// @param alignment must be a power of two
+void * sharedArena_allocateAligned(sharedArena_t * arena, uint64_t sizeBytes, uint64_t alignment);
+/// Allocate an object aligned to SIMULATOR_CACHE_LINE_SIZE and register it in the directory. The name must be unique - e.g. the debugName of a channel.
+void * sharedArena_allocateNamed(sharedArena_t * arena, const char * name, uint64_t sizeBytes);
+/// Master process: the setup is complete - the processes waiting in sharedArena_attach() continue
+void sharedArena_publish(sharedArena_t * arena);
+/// Other processes: wait until the master published the arena in the region
+sharedArena_t * sharedArena_attach(void * region);
+/// Look up a named object
+/// @return the object or NULL when no object is registered with the name
+void * sharedArena_find(sharedArena_t * arena, const char * name);
+/// Offset of an object of the arena from the start of the region
+uint64_t sharedArena_offsetOf(sharedArena_t * arena, const void * object);
+
+#endif /* SIMULATOR_SHAREDARENA_H_ */
@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
  */
 
+#define _GNU_SOURCE
 #include "sharedMemory.h"
 
 #include <stdio.h>
@@ -32,22 +33,86 @@ SOFTWARE.
 #include <sys/shm.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/vfs.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include "assert.h"
 
 #define TIMEOUT_MILLIS 10000
+/// Mount point of hugetlbfs used when the SIMULATOR_HUGETLBFS environment variable is not set
+#define DEFAULT_HUGETLBFS_PATH "/dev/hugepages"
+/// Transparent huge pages are 2MiB on AMD64 - the mapping is aligned to this so the whole region can be backed by huge pages
+#define TRANSPARENT_HUGE_PAGE_SIZE (2ul<<20)
 
-void * sharedMemory_open(const char * name, uint32_t sizeBytes, bool master)
+/// Open the object of the shared memory: a POSIX shared memory object or a file in hugetlbfs
+static int sharedMemory_openObject(const char * name, uint32_t options, int flags)
+{
+  if(options&SHARED_MEMORY_HUGE_PAGES)
+  {
+    const char * mount=getenv("SIMULATOR_HUGETLBFS");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", mount!=NULL?mount:DEFAULT_HUGETLBFS_PATH, name[0]=='/'?name+1:name);
+    return open(path, flags, 0666);
+  }
+  return shm_open(name, flags, 0666);
+}
+
+/// Page size of the object: the huge page size of hugetlbfs or the base page size
+static uint64_t sharedMemory_pageSize(uint32_t options)
+{
+  if(options&SHARED_MEMORY_HUGE_PAGES)
+  {
+    const char * mount=getenv("SIMULATOR_HUGETLBFS");
+    struct statfs fs;
+    assertMsg(statfs(mount!=NULL?mount:DEFAULT_HUGETLBFS_PATH, &fs)==0, "hugetlbfs is not mounted at %s", mount!=NULL?mount:DEFAULT_HUGETLBFS_PATH);
+    return fs.f_bsize;
+  }
+  return sysconf(_SC_PAGESIZE);
+}
+
+/// Size of the object of the shared memory: hugetlbfs objects are allocated in whole huge pages
+static uint64_t sharedMemory_objectSize(uint64_t sizeBytes, uint32_t options)
+{
+  if(!(options&SHARED_MEMORY_HUGE_PAGES))
+  {
+    return sizeBytes;
+  }
+  uint64_t pageSize=sharedMemory_pageSize(options);
+  return (sizeBytes+pageSize-1)/pageSize*pageSize;
+}
+
+/// Map the object of the shared memory with the options and close its descriptor
+static void * sharedMemory_map(int fd, uint64_t sizeBytes, uint32_t options);
+
+/// Reserve an address range aligned to alignment where sizeBytes can be mapped with MAP_FIXED
+static void * sharedMemory_reserveAligned(uint64_t sizeBytes, uint64_t alignment)
+{
+  uint8_t * reserved=mmap(NULL, sizeBytes+alignment, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  assertErrno(reserved!=MAP_FAILED);
+  uint8_t * aligned=(uint8_t *)((((uintptr_t)reserved)+alignment-1)&~(alignment-1));
+  if(aligned>reserved)
+  {
+    munmap(reserved, aligned-reserved);
+  }
+  munmap(aligned+sizeBytes, reserved+alignment-aligned);
+  return aligned;
+}
+
+void * sharedMemory_open(const char * name, uint64_t sizeBytes, bool master)
+{
+  return sharedMemory_openWithOptions(name, sizeBytes, master, 0);
+}
+
+void * sharedMemory_openWithOptions(const char * name, uint64_t sizeBytes, bool master, uint32_t options)
 {
     /* shared memory file descriptor */
     int shm_fd=-1;
 
-    /* pointer to shared memory object */
-    void* ptr;
-
+    sizeBytes=sharedMemory_objectSize(sizeBytes, options);
     if(master)
     {
 		/* create the shared memory object */
-		shm_fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+		shm_fd = sharedMemory_openObject(name, options, O_CREAT | O_RDWR);
 
     assertErrno(shm_fd>=0);
 
@@ -59,7 +124,7 @@ void * sharedMemory_open(const char * name, uint32_t sizeBytes, bool master)
         /* open the shared memory object */
     	while(shm_fd==-1)
     	{
-    		shm_fd = shm_open(name, O_RDWR, 0666);
+    		shm_fd = sharedMemory_openObject(name, options, O_RDWR);
     		if(shm_fd==-1)
     		{
     			ctr++;
@@ -73,9 +138,160 @@ void * sharedMemory_open(const char * name, uint32_t sizeBytes, bool master)
 
         assertErrno(shm_fd>=0);
     }
-    /* memory map the shared memory object to the same address in each process: */
-    void * sharedPtr=(void *)0x10000;
-    ptr = mmap(sharedPtr, sizeBytes, PROT_WRITE, MAP_SHARED|MAP_FIXED, shm_fd, 0);
+    return sharedMemory_map(shm_fd, sizeBytes, options);
+}
+
+static void * sharedMemory_map(int fd, uint64_t sizeBytes, uint32_t options)
+{
+    /* memory map the shared memory object at any address: the objects in the region only use relative pointers */
+    int flags=MAP_SHARED;
+    void * at=NULL;
+    if(options&SHARED_MEMORY_PREFAULT)
+    {
+      flags|=MAP_POPULATE;
+    }
+    if(options&SHARED_MEMORY_TRANSPARENT_HUGE_PAGES)
+    {
+      at=sharedMemory_reserveAligned(sizeBytes, TRANSPARENT_HUGE_PAGE_SIZE);
+      flags|=MAP_FIXED;
+    }
+    void * ptr = mmap(at, sizeBytes, PROT_READ|PROT_WRITE, flags, fd, 0);
     assertErrno(ptr!=MAP_FAILED);
+    close(fd);
+    if(options&SHARED_MEMORY_TRANSPARENT_HUGE_PAGES)
+    {
+      /* Only a hint: the kernel uses huge pages for shared memory when transparent_hugepage/shmem_enabled is advise, within_size or always */
+      madvise(ptr, sizeBytes, MADV_HUGEPAGE);
+    }
+    if(options&SHARED_MEMORY_LOCK)
+    {
+      assertMsg(mlock(ptr, sizeBytes)==0, "Locking %lu bytes of shared memory failed - see RLIMIT_MEMLOCK", (unsigned long)sizeBytes);
+    }
     return ptr;
 }
+
+bool sharedMemory_bindToNode(void * address, uint64_t sizeBytes, int node)
+{
+  unsigned long nodeMask;
+  if(node<0 || node>=(int)(sizeof(nodeMask)*8))
+  {
+    return false;
+  }
+  long pageSize=sysconf(_SC_PAGESIZE);
+  uintptr_t start=((uintptr_t)address)&~(pageSize-1);
+  uintptr_t end=(((uintptr_t)address)+sizeBytes+pageSize-1)&~(pageSize-1);
+  nodeMask=1ul<<node;
+  // Preferred instead of bind: the memory is still allocated when the node is full. Pages already faulted in by this process are moved.
+  // The kernel reads only maxnode-1 bits of the mask so one more than the bits of the mask is passed - otherwise the last node is rejected.
+  return syscall(SYS_mbind, start, end-start, MPOL_PREFERRED, &nodeMask, sizeof(nodeMask)*8+1, MPOL_MF_MOVE)==0;
+}
+
+void sharedMemory_prefault(void * address, uint64_t sizeBytes)
+{
+  if(madvise(address, sizeBytes, MADV_POPULATE_WRITE)!=0)
+  {
+    /* Kernels before 5.14: fault the pages in by reading them - safe while other processes already use the region */
+    long pageSize=sysconf(_SC_PAGESIZE);
+    for(uint64_t offset=0;offset<sizeBytes;offset+=pageSize)
+    {
+      (void)*(volatile uint8_t *)(((uint8_t *)address)+offset);
+    }
+  }
+}
+
+int sharedMemory_currentNode(void)
+{
+  unsigned int cpu;
+  unsigned int node;
+  if(syscall(SYS_getcpu, &cpu, &node, NULL)!=0)
+  {
+    return -1;
+  }
+  return node;
+}
+
+void * sharedMemory_restore(const char * name, const char * path, uint64_t sizeBytes)
+{
+  return sharedMemory_restoreWithOptions(name, path, sizeBytes, 0);
+}
+
+void * sharedMemory_restoreWithOptions(const char * name, const char * path, uint64_t sizeBytes, uint32_t options)
+{
+  int fd=open(path, O_RDONLY);
+  assertErrno(fd>=0);
+  struct stat st;
+  assertErrno(fstat(fd, &st)==0);
+  assertMsg((uint64_t)st.st_size==sizeBytes, "Size of the region file differs from the size of the shared memory");
+  /* the object is sized the same way as by sharedMemory_openWithOptions() - the rest after the file stays zero */
+  uint64_t objectSize=sharedMemory_objectSize(sizeBytes, options);
+  int shm_fd=sharedMemory_openObject(name, options, O_CREAT | O_RDWR | O_TRUNC);
+  assertErrno(shm_fd>=0);
+  assertErrno(ftruncate(shm_fd, objectSize)==0);
+  void * ptr=sharedMemory_map(shm_fd, objectSize, options);
+  /* read the file straight into the mapped region */
+  uint64_t offset=0;
+  while(offset<sizeBytes)
+  {
+    ssize_t n=read(fd, ((uint8_t *)ptr)+offset, sizeBytes-offset);
+    assertErrno(n>0);
+    offset+=n;
+  }
+  close(fd);
+  return ptr;
+}
+
+/// Map the sizeBytes long part of the file from offset twice back to back starting at address at.
+static void sharedMemory_mapTwice(int fd, uint32_t offset, uint32_t sizeBytes, uint8_t * at)
+{
+  void * ptr=mmap(at, sizeBytes, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, offset);
+  assertErrno(ptr!=MAP_FAILED);
+  ptr=mmap(at+sizeBytes, sizeBytes, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_FIXED, fd, offset);
+  assertErrno(ptr!=MAP_FAILED);
+}
+
+void * sharedMemory_allocatePrivate(uint64_t sizeBytes)
+{
+  void * ptr=mmap(NULL, sizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  assertErrno(ptr!=MAP_FAILED);
+  return ptr;
+}
+
+void sharedMemory_freePrivate(void * region, uint64_t sizeBytes)
+{
+  assertErrno(munmap(region, sizeBytes)==0);
+}
+
+uint8_t * sharedMemory_allocateMirrored(uint32_t sizeBytes)
+{
+  assert(sizeBytes>0 && sizeBytes%sysconf(_SC_PAGESIZE)==0);
+  int fd=memfd_create("simulatorMirrored", 0);
+  assertErrno(fd>=0);
+  assertErrno(ftruncate(fd, sizeBytes)==0);
+  /* reserve continuous address space for the two mappings */
+  uint8_t * ptr=mmap(NULL, 2ul*sizeBytes, PROT_NONE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  assertErrno(ptr!=MAP_FAILED);
+  sharedMemory_mapTwice(fd, 0, sizeBytes, ptr);
+  close(fd);
+  return ptr;
+}
+
+void sharedMemory_freeMirrored(uint8_t * buffer, uint32_t sizeBytes)
+{
+  assertErrno(munmap(buffer, 2ul*sizeBytes)==0);
+}
+
+void sharedMemory_mirrorRange(const char * name, void * region, uint32_t offset, uint32_t sizeBytes)
+{
+  sharedMemory_mirrorRangeWithOptions(name, region, offset, sizeBytes, 0);
+}
+
+void sharedMemory_mirrorRangeWithOptions(const char * name, void * region, uint32_t offset, uint32_t sizeBytes, uint32_t options)
+{
+  /* a hugetlbfs object can only be mapped in whole huge pages */
+  uint64_t pageSize=sharedMemory_pageSize(options);
+  assertMsg(sizeBytes>0 && sizeBytes%pageSize==0 && offset%pageSize==0, "Mirrored range of %u bytes at %u is not aligned to the page size %lu", sizeBytes, offset, (unsigned long)pageSize);
+  int fd=sharedMemory_openObject(name, options, O_RDWR);
+  assertErrno(fd>=0);
+  sharedMemory_mapTwice(fd, offset, sizeBytes, ((uint8_t *)region)+offset);
+  close(fd);
+}
@@ -26,14 +26,73 @@ SOFTWARE.
 #define SIM_PC_SIMULATOR_SHAREDMEMORY_H_
 
 /// Open/create shared memory used by the simulator.
+/// The objects are placed into the region by an arena allocator and found by name by the other processes (see sharedArena.h).
 
 #include "simulator_types.h"
 
 /// Open the shared memory instance of the simulation instance.
 /// File name of the shared memory object is default or got from environment variable.
-/// The shared memory is mapped to the same pointer in each processes. The shared memory is intended to hold the simulator related objects (channels)
+/// The shared memory may be mapped to a different address in each process: the simulator objects (channels, sinks, ringbuffers) only point into the region
+/// using relative pointers (see relativePtr_t) and the processes find the objects by name (see sharedArena.h). So many independent simulation instances
+/// with different names can run on the same host. The shared memory is intended to hold the simulator related objects (channels)
 /// And communication between the MCUs (processes or threads) is done using this shared memory.
 /// @param master true means this is the master process and should create the shared memory. False means this is not master and should wait for shm to exist.
-void * sharedMemory_open(const char * name, uint32_t sizeBytes, bool master);
+void * sharedMemory_open(const char * name, uint64_t sizeBytes, bool master);
+/// Options of the backing of the shared memory (see sharedMemory_openWithOptions())
+/// The object is a file in hugetlbfs instead of a POSIX shared memory object: the region is backed by explicit huge pages that must be reserved
+/// in the system (vm.nr_hugepages). The mount point is /dev/hugepages or the SIMULATOR_HUGETLBFS environment variable. The size is rounded up to the huge page size
+/// and the ranges of sharedMemory_mirrorRangeWithOptions() must be aligned to it.
+#define SHARED_MEMORY_HUGE_PAGES 1
+/// The mapping is aligned to the transparent huge page size and marked with MADV_HUGEPAGE. Huge pages are only used when
+/// /sys/kernel/mm/transparent_hugepage/shmem_enabled is not never.
+#define SHARED_MEMORY_TRANSPARENT_HUGE_PAGES 2
+/// Fault all pages in when the region is mapped (MAP_POPULATE) so the first simulated events do not pay for page faults
+#define SHARED_MEMORY_PREFAULT 4
+/// Lock the region into memory (mlock) - limited by RLIMIT_MEMLOCK
+#define SHARED_MEMORY_LOCK 8
+/// Same as sharedMemory_open() with options of the backing. All processes must use the same options.
+/// @param options bitwise or of the SHARED_MEMORY_ options
+void * sharedMemory_openWithOptions(const char * name, uint64_t sizeBytes, bool master, uint32_t options);
+/// Set the NUMA memory policy of a part of the region: its pages are allocated on the given node - e.g. the ringbuffer of a sink
+/// on the node of the process reading it (see channelObjectSink_bindToNode()). The range is extended to whole pages.
+/// Pages already faulted in and only mapped by the calling process are moved. Only a performance hint: the memory is still allocated elsewhere when the node is full.
+/// @return false when the policy could not be set (e.g. the kernel has no NUMA support)
+bool sharedMemory_bindToNode(void * address, uint64_t sizeBytes, int node);
+/// Fault in the pages of a part of the region. Used instead of SHARED_MEMORY_PREFAULT when the NUMA policy of the parts is set after the region is opened:
+/// the master binds the ringbuffers of the sinks to the nodes of their readers then prefaults the region.
+void sharedMemory_prefault(void * address, uint64_t sizeBytes);
+/// NUMA node of the CPU that executes the calling thread - -1 when not known
+int sharedMemory_currentNode(void);
+/// Master process: create the shared memory instance from a region file written by checkpoint_saveRegion() and map it the same way as sharedMemory_open().
+/// Must be called before the other processes of the simulation are started - they open the restored instance using sharedMemory_open().
+/// Each restore creates an independent copy so many simulations can be continued from the same checkpoint.
+/// @param path the region file of the checkpoint
+void * sharedMemory_restore(const char * name, const char * path, uint64_t sizeBytes);
+/// Same as sharedMemory_restore() with options of the backing (see sharedMemory_openWithOptions()). The other processes must open the instance with the same options.
+void * sharedMemory_restoreWithOptions(const char * name, const char * path, uint64_t sizeBytes, uint32_t options);
+/// Allocate zero filled process local memory for the simulator objects of clocks simulated by the threads of the same process (see localClock_startThread()).
+/// Same use as the region returned by sharedMemory_open() but no shared memory object is created.
+/// @param sizeBytes size of the region in bytes
+void * sharedMemory_allocatePrivate(uint64_t sizeBytes);
+/// Release memory allocated by sharedMemory_allocatePrivate()
+void sharedMemory_freePrivate(void * region, uint64_t sizeBytes);
+/// Allocate a process local buffer that is mapped twice back to back in the virtual memory: the 2*sizeBytes long returned area
+/// has the same memory pages in its two halves. Used as storage of ringBuffer_createMirrored() when the writer and reader are in the same process.
+/// @param sizeBytes must be a multiple of the page size
+uint8_t * sharedMemory_allocateMirrored(uint32_t sizeBytes);
+/// Release a buffer allocated by sharedMemory_allocateMirrored()
+void sharedMemory_freeMirrored(uint8_t * buffer, uint32_t sizeBytes);
+/// Map the pages of a part of the shared memory a second time right after itself so that it can be used as the storage of ringBuffer_createMirrored().
+/// The sizeBytes long part of the region after the buffer is remapped to the buffer itself so the region must have 2*sizeBytes reserved for the buffer.
+/// Must be called by each process after sharedMemory_open() because mappings are not shared between processes.
+/// @param name name of the shared memory object as passed to sharedMemory_open()
+/// @param region pointer returned by sharedMemory_open()
+/// @param offset offset of the buffer inside the region - must be a multiple of the page size
+/// @param sizeBytes size of the buffer - must be a multiple of the page size
+void sharedMemory_mirrorRange(const char * name, void * region, uint32_t offset, uint32_t sizeBytes);
+/// Same as sharedMemory_mirrorRange() for a region opened by sharedMemory_openWithOptions(). With SHARED_MEMORY_HUGE_PAGES the offset and the size
+/// must be multiples of the huge page size.
+/// @param options the options the region was opened with
+void sharedMemory_mirrorRangeWithOptions(const char * name, void * region, uint32_t offset, uint32_t sizeBytes, uint32_t options);
 
 #endif /* SIM_PC_SIMULATOR_SHAREDMEMORY_H_ */
@@ -29,10 +29,23 @@ SOFTWARE.
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /// 128 bit integer - not standard but gcc implements on AMD64
 typedef __int128 int128_t;
 /// 128 bit unsigned integer - not standard but gcc implements on AMD64
 typedef unsigned __int128 uint128_t;
 
+/// Size of a cache line in bytes. Fields written by different processes are placed on different cache lines
+/// so that a write on one side does not invalidate the data used by the other side.
+#define SIMULATOR_CACHE_LINE_SIZE 64
+
+/// Self relative pointer: the distance of the target from the pointer field itself. Structures in shared memory point into the same region this way
+/// so the region can be mapped at a different address in each process (see sharedMemory_open()). 0 means NULL.
+typedef int64_t relativePtr_t;
+/// Set the relative pointer field to point to the target
+#define relativePtr_set(field, target) ((field)=(target)==NULL?0:(relativePtr_t)((intptr_t)(target)-(intptr_t)&(field)))
+/// Get the target of the relative pointer field as a pointer of the type
+#define relativePtr_get(field, type) ((field)==0?(type *)NULL:(type *)((intptr_t)&(field)+(field)))
+
 #endif /* SIM_PC_SIMULATOR_SIMULATOR_TYPES_H_ */
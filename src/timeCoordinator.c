@@ -0,0 +1,148 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "timeCoordinator.h"
+#include "assert.h"
+
+/// Read the entry. Retries while the entry is being updated.
+/// @return version of the entry - fields read are consistent with this version
+static uint32_t timeCoordinator_readEntry(timeCoordinator_entry_t * entry, timeCoordinator_entry_t * copy);
+/// Start or finish an update of the entry
+static inline void timeCoordinator_beginUpdate(timeCoordinator_entry_t * entry);
+static inline void timeCoordinator_endUpdate(timeCoordinator_entry_t * entry);
+
+void timeCoordinator_create(timeCoordinator_t * tc)
+{
+  for(uint32_t i=0;i<TIME_COORDINATOR_MAX_CLOCKS;++i)
+  {
+    timeCoordinator_entry_t * entry=&(tc->entries[i]);
+    atomic_init(&(entry->version), 0);
+    entry->waiting=false;
+    entry->horizon=0;
+    entry->sent=0;
+    entry->observed=0;
+  }
+  atomic_init(&(tc->gvt), 0);
+  atomic_init(&(tc->nClock), 0);
+}
+
+uint32_t timeCoordinator_attach(timeCoordinator_t * tc)
+{
+  uint32_t index=atomic_fetch_add(&(tc->nClock), 1);
+  assert(index<TIME_COORDINATOR_MAX_CLOCKS);
+  return index;
+}
+
+static inline void timeCoordinator_beginUpdate(timeCoordinator_entry_t * entry)
+{
+  atomic_fetch_add_explicit(&(entry->version), 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+static inline void timeCoordinator_endUpdate(timeCoordinator_entry_t * entry)
+{
+  atomic_fetch_add_explicit(&(entry->version), 1, memory_order_release);
+}
+
+void timeCoordinator_setWaiting(timeCoordinator_t * tc, uint32_t index, uint64_t horizon, uint64_t sent, uint64_t observed)
+{
+  timeCoordinator_entry_t * entry=&(tc->entries[index]);
+  timeCoordinator_beginUpdate(entry);
+  entry->horizon=horizon;
+  entry->sent=sent;
+  entry->observed=observed;
+  entry->waiting=true;
+  timeCoordinator_endUpdate(entry);
+}
+
+void timeCoordinator_setActive(timeCoordinator_t * tc, uint32_t index)
+{
+  timeCoordinator_entry_t * entry=&(tc->entries[index]);
+  timeCoordinator_beginUpdate(entry);
+  entry->waiting=false;
+  timeCoordinator_endUpdate(entry);
+}
+
+static uint32_t timeCoordinator_readEntry(timeCoordinator_entry_t * entry, timeCoordinator_entry_t * copy)
+{
+  while(true)
+  {
+    uint32_t version=atomic_load_explicit(&(entry->version), memory_order_acquire);
+    if((version&1)==0)
+    {
+      copy->waiting=((volatile timeCoordinator_entry_t *)entry)->waiting;
+      copy->horizon=((volatile timeCoordinator_entry_t *)entry)->horizon;
+      copy->sent=((volatile timeCoordinator_entry_t *)entry)->sent;
+      copy->observed=((volatile timeCoordinator_entry_t *)entry)->observed;
+      atomic_thread_fence(memory_order_acquire);
+      if(atomic_load_explicit(&(entry->version), memory_order_relaxed)==version)
+      {
+        return version;
+      }
+    }
+  }
+}
+
+uint64_t timeCoordinator_compute(timeCoordinator_t * tc)
+{
+  uint32_t nClock=atomic_load_explicit(&(tc->nClock), memory_order_acquire);
+  uint32_t versions[TIME_COORDINATOR_MAX_CLOCKS];
+  uint64_t gvt=UINT64_MAX;
+  uint64_t sent=0;
+  uint64_t observed=0;
+  // First collect: all clocks must wait
+  for(uint32_t i=0;i<nClock;++i)
+  {
+    timeCoordinator_entry_t entry;
+    versions[i]=timeCoordinator_readEntry(&(tc->entries[i]), &entry);
+    if(!entry.waiting)
+    {
+      return atomic_load_explicit(&(tc->gvt), memory_order_acquire);
+    }
+    sent+=entry.sent;
+    observed+=entry.observed;
+    if(entry.horizon<gvt)
+    {
+      gvt=entry.horizon;
+    }
+  }
+  // Events in flight may cause an action earlier than any horizon
+  if(nClock==0 || sent!=observed)
+  {
+    return atomic_load_explicit(&(tc->gvt), memory_order_acquire);
+  }
+  // Second collect: no entry changed since the first collect so all clocks were waiting with the read state at the same time
+  atomic_thread_fence(memory_order_acquire);
+  for(uint32_t i=0;i<nClock;++i)
+  {
+    if(atomic_load_explicit(&(tc->entries[i].version), memory_order_relaxed)!=versions[i])
+    {
+      return atomic_load_explicit(&(tc->gvt), memory_order_acquire);
+    }
+  }
+  uint64_t current=atomic_load_explicit(&(tc->gvt), memory_order_relaxed);
+  while(current<gvt && !atomic_compare_exchange_weak(&(tc->gvt), &current, gvt))
+  {
+  }
+  return current<gvt?gvt:current;
+}
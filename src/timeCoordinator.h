@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_TIMECOORDINATOR_H_
+#define SIMULATOR_TIMECOORDINATOR_H_
+
+/// Global virtual time (GVT) coordinator. Optional structure in shared memory that lets all clocks jump over periods where every simulator
+/// is idle - waiting for its inputs with no event in flight. Without it the clocks advance such periods in minimalLatency steps of the channel handshakes.
+///
+/// Each attached clock publishes its state when it starts waiting for an input: the earliest timestamp it may act by itself (target time, next timer,
+/// next event in its input ringbuffers) and the number of events it sent and observed in its channels. When all clocks wait and every event sent was observed
+/// by its receiver then the minimum of the published timestamps is the GVT: no simulator can act earlier. Each clock marks its outputs simulated until the GVT
+/// so the neighbours can advance directly to the GVT.
+
+#include "simulator_types.h"
+#include <stdatomic.h>
+
+/// Maximum number of clocks attached to a coordinator
+#define TIME_COORDINATOR_MAX_CLOCKS 64
+
+/// State published by one clock. Written only by the clock, read by all waiting clocks.
+typedef struct
+{
+  /// Incremented before and after each update: odd while the entry is updated
+  _Alignas(SIMULATOR_CACHE_LINE_SIZE) _Atomic uint32_t version;
+  /// The clock is waiting for its inputs and does not act until horizon or until an input event
+  bool waiting;
+  /// Earliest timestamp the clock acts by itself - valid while waiting
+  uint64_t horizon;
+  /// Number of events inserted into the output channels multiplied by the number of their sinks
+  uint64_t sent;
+  /// Number of events inserted into the channels of the input sinks - all of them are in the ringbuffer or processed
+  uint64_t observed;
+} timeCoordinator_entry_t;
+
+/// The coordinator. Must be stored in shared memory accessed by all attached clocks.
+typedef struct timeCoordinator_str
+{
+  /// Number of attached clocks
+  _Atomic uint32_t nClock;
+  /// Largest GVT computed so far. GVT never decreases: no clock acts earlier than this timestamp.
+  _Alignas(SIMULATOR_CACHE_LINE_SIZE) _Atomic uint64_t gvt;
+  timeCoordinator_entry_t entries[TIME_COORDINATOR_MAX_CLOCKS];
+} timeCoordinator_t;
+
+/// Initialize the coordinator with no clocks attached
+void timeCoordinator_create(timeCoordinator_t * tc);
+/// Attach a new clock to the coordinator. The clock is not waiting until it publishes its first waiting state.
+/// All clocks that send events to attached clocks must be attached otherwise GVT is never found.
+/// @return index of the entry of the clock
+uint32_t timeCoordinator_attach(timeCoordinator_t * tc);
+/// Publish the state of the clock: waiting with the given horizon and event counters
+void timeCoordinator_setWaiting(timeCoordinator_t * tc, uint32_t index, uint64_t horizon, uint64_t sent, uint64_t observed);
+/// Publish the state of the clock: it acts - GVT can not be computed until it waits again
+void timeCoordinator_setActive(timeCoordinator_t * tc, uint32_t index);
+/// Try to compute the GVT from a consistent snapshot of the entries: all clocks wait and all events sent were observed.
+/// @return the largest GVT found so far - 0 when it was never found
+uint64_t timeCoordinator_compute(timeCoordinator_t * tc);
+
+#endif /* SIMULATOR_TIMECOORDINATOR_H_ */
@@ -0,0 +1,451 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "timeWarp.h"
+#include "channelObject.h"
+#include "assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// Header of an event in the output log
+typedef struct
+{
+  channelObject_t * co;
+  uint64_t timestamp;
+  /// Global time of the clock when the event was inserted - the event is committed when this time is committed
+  uint64_t generatedAt;
+  uint32_t size;
+  /// Number of events committed together starting with this one: 1 for a single event, 0 for the following events of a batch
+  uint32_t nBatch;
+  /// Distance of the timestamps of the events of the batch: 0 for a same timestamp group, 1 otherwise
+  uint32_t timestampStep;
+  /// Number of write positions following the header: the event was sent speculatively to the ringbuffers at these positions. 0 when it is buffered.
+  uint32_t nPositions;
+} timeWarp_output_t;
+
+/// Size of an event in the output log: the header, the write positions and the payload - entries are 8 byte aligned
+#define TIME_WARP_OUTPUT_SIZE(size, nPositions) ((sizeof(timeWarp_output_t)+(nPositions)*sizeof(uint64_t)+(size)+7u)&~7u)
+/// Write positions of the event sent speculatively (see channelObject_sendSpeculative())
+#define timeWarp_outputPositions(output) ((uint64_t *)((output)+1))
+/// Payload of the event
+#define timeWarp_outputData(output) ((uint8_t *)(timeWarp_outputPositions(output)+(output)->nPositions))
+
+/// Number of inputs of the clock: simulate inputs then flush inputs
+static inline uint32_t timeWarp_nInputs(localClock_t * lc);
+/// Input sink by index: simulate inputs then flush inputs
+static inline channelObjectSink_t * timeWarp_input(localClock_t * lc, uint32_t index);
+/// Snapshot by index counted from the oldest snapshot
+static inline timeWarp_snapshot_t * timeWarp_getSnapshot(timeWarp_t * tw, uint32_t index);
+/// State of the output channel - the entry of the channel in channels
+static timeWarp_channel_t * timeWarp_channel(timeWarp_t * tw, channelObject_t * co);
+/// Delay the timestamp of an event the same way as the commit will delay it so the event is committed at the returned timestamp
+static uint64_t timeWarp_delay(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp);
+/// Decide whether events are sent speculatively: they fit into the ringbuffers and no earlier event of the channel waits in the output log
+static bool timeWarp_canSend(timeWarp_t * tw, channelObject_t * co, uint32_t nEvents, uint32_t payloadBytes);
+/// Append an event to the output log. Sends the event speculatively when send is set and the channel has sinks
+static void timeWarp_append(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size, uint32_t nBatch, uint32_t timestampStep, bool send);
+
+timeWarp_t * timeWarp_create(uint32_t maxSnapshots, uint32_t stateSize, localClock_stateCallback_t save, localClock_stateCallback_t restore, void * parameter)
+{
+  assert(maxSnapshots>0);
+  timeWarp_t * tw=malloc(sizeof(timeWarp_t));
+  assert(tw!=NULL);
+  tw->snapshots=calloc(maxSnapshots, sizeof(timeWarp_snapshot_t));
+  assert(tw->snapshots!=NULL);
+  tw->maxSnapshots=maxSnapshots;
+  tw->firstSnapshot=0;
+  tw->nSnapshots=0;
+  tw->stateSize=stateSize;
+  tw->save=save;
+  tw->restore=restore;
+  tw->parameter=parameter;
+  for(uint32_t i=0;i<maxSnapshots;++i)
+  {
+    tw->snapshots[i].state=stateSize>0?malloc(stateSize):NULL;
+    assert(stateSize==0 || tw->snapshots[i].state!=NULL);
+  }
+  tw->outputLog=NULL;
+  tw->outputLogSize=0;
+  tw->outputLogCapacity=0;
+  tw->outputCommitted=0;
+  tw->committing=false;
+  tw->committedUntil=0;
+  tw->channels=NULL;
+  tw->nChannels=0;
+  tw->batchData=NULL;
+  tw->batchSizes=NULL;
+  tw->batchCapacity=0;
+  return tw;
+}
+
+void timeWarp_destroy(timeWarp_t * tw)
+{
+  for(uint32_t i=0;i<tw->maxSnapshots;++i)
+  {
+    free(tw->snapshots[i].timers);
+    free(tw->snapshots[i].timerHeap);
+    free(tw->snapshots[i].inputPositions);
+    free(tw->snapshots[i].state);
+  }
+  free(tw->snapshots);
+  free(tw->outputLog);
+  free(tw->channels);
+  free(tw->batchData);
+  free(tw->batchSizes);
+  free(tw);
+}
+
+static inline uint32_t timeWarp_nInputs(localClock_t * lc)
+{
+  return lc->nChannelInSimulate+lc->nChannelInFlush;
+}
+
+static inline channelObjectSink_t * timeWarp_input(localClock_t * lc, uint32_t index)
+{
+  return index<lc->nChannelInSimulate?lc->channelsInSimulate[index]:lc->channelsInFlush[index-lc->nChannelInSimulate];
+}
+
+static inline timeWarp_snapshot_t * timeWarp_getSnapshot(timeWarp_t * tw, uint32_t index)
+{
+  return &(tw->snapshots[(tw->firstSnapshot+index)%tw->maxSnapshots]);
+}
+
+bool timeWarp_snapshot(localClock_t * lc)
+{
+  timeWarp_t * tw=lc->timeWarp;
+  if(tw->nSnapshots==tw->maxSnapshots)
+  {
+    return false;
+  }
+  timeWarp_snapshot_t * s=timeWarp_getSnapshot(tw, tw->nSnapshots);
+  s->globalTime=lc->globalTime;
+  if(s->nTimers<lc->nTimers)
+  {
+    s->timers=realloc(s->timers, lc->nTimers*sizeof(localClock_timer_t));
+    s->timerHeap=realloc(s->timerHeap, lc->nTimers*sizeof(uint32_t));
+    assert(s->timers!=NULL && s->timerHeap!=NULL);
+  }
+  s->nTimers=lc->nTimers;
+  memcpy(s->timers, lc->timers, lc->nTimers*sizeof(localClock_timer_t));
+  memcpy(s->timerHeap, lc->timerHeap, lc->nTimerHeap*sizeof(uint32_t));
+  s->nTimerHeap=lc->nTimerHeap;
+  s->freeTimer=lc->freeTimer;
+  s->isrGlobalEnabled=lc->isrGlobalEnabled;
+  s->isrsFlag=lc->isrsFlag;
+  s->isrsEnabled=lc->isrsEnabled;
+  uint32_t nInputs=timeWarp_nInputs(lc);
+  if(s->nInputs<nInputs)
+  {
+    s->inputPositions=realloc(s->inputPositions, nInputs*sizeof(uint64_t));
+    assert(s->inputPositions!=NULL);
+  }
+  s->nInputs=nInputs;
+  for(uint32_t i=0;i<nInputs;++i)
+  {
+    s->inputPositions[i]=channelObjectSink_getSpeculativePosition(timeWarp_input(lc, i));
+  }
+  s->outputPosition=tw->outputCommitted+tw->outputLogSize;
+  if(tw->save!=NULL)
+  {
+    tw->save(lc, tw->parameter, s->state);
+  }
+  tw->nSnapshots++;
+  return true;
+}
+
+void timeWarp_rollback(localClock_t * lc, uint64_t timestamp)
+{
+  timeWarp_t * tw=lc->timeWarp;
+  assert(tw->nSnapshots>0);
+  uint32_t index=tw->nSnapshots-1;
+  while(index>0 && timeWarp_getSnapshot(tw, index)->globalTime>=timestamp)
+  {
+    index--;
+  }
+  timeWarp_snapshot_t * s=timeWarp_getSnapshot(tw, index);
+  // The oldest snapshot is not later than the commit time and stragglers are always later than the commit time
+  assert(s->globalTime<timestamp);
+  lc->globalTime=s->globalTime;
+  memcpy(lc->timers, s->timers, s->nTimers*sizeof(localClock_timer_t));
+  memcpy(lc->timerHeap, s->timerHeap, s->nTimerHeap*sizeof(uint32_t));
+  lc->nTimerHeap=s->nTimerHeap;
+  lc->freeTimer=s->freeTimer;
+  for(uint32_t i=lc->nTimers;i>s->nTimers;--i)
+  {
+    // Timer storage grown after the snapshot - the new timers are not allocated
+    localClock_timer_t * timer=&(lc->timers[i-1]);
+    timer->allocated=false;
+    timer->enabled=false;
+    timer->heapIndex=CLOCK_TIMER_NOT_ARMED;
+    timer->nextFree=lc->freeTimer;
+    lc->freeTimer=i-1;
+  }
+  lc->isrGlobalEnabled=s->isrGlobalEnabled;
+  lc->isrsFlag=s->isrsFlag;
+  lc->isrsEnabled=s->isrsEnabled;
+  for(uint32_t i=0;i<s->nInputs;++i)
+  {
+    channelObjectSink_setSpeculativePosition(timeWarp_input(lc, i), s->inputPositions[i]);
+  }
+  // Events generated after the snapshot are dropped - the ones already sent are cancelled in the ringbuffers of the readers
+  assert(s->outputPosition>=tw->outputCommitted);
+  uint32_t logSize=(uint32_t)(s->outputPosition-tw->outputCommitted);
+  for(uint32_t offset=logSize;offset<tw->outputLogSize;)
+  {
+    timeWarp_output_t * output=(timeWarp_output_t *)(tw->outputLog+offset);
+    if(output->nPositions>0)
+    {
+      channelObject_cancelSpeculative(output->co, output->timestamp, output->nPositions, timeWarp_outputPositions(output));
+    }
+    offset+=TIME_WARP_OUTPUT_SIZE(output->size, output->nPositions);
+  }
+  tw->outputLogSize=logSize;
+  // The dropped events do not delay the later events of their channels
+  memset(tw->channels, 0, tw->nChannels*sizeof(timeWarp_channel_t));
+  for(uint32_t offset=0;offset<tw->outputLogSize;)
+  {
+    timeWarp_output_t * output=(timeWarp_output_t *)(tw->outputLog+offset);
+    timeWarp_channel_t * channel=timeWarp_channel(tw, output->co);
+    if(output->timestamp>channel->bufferedUntil)
+    {
+      channel->bufferedUntil=output->timestamp;
+    }
+    if(output->nPositions==0)
+    {
+      channel->nUnsent++;
+    }
+    offset+=TIME_WARP_OUTPUT_SIZE(output->size, output->nPositions);
+  }
+  if(tw->restore!=NULL)
+  {
+    tw->restore(lc, tw->parameter, s->state);
+  }
+  // The restored snapshot is kept: the simulation may be rolled back to it again
+  tw->nSnapshots=index+1;
+}
+
+void timeWarp_commit(localClock_t * lc, uint64_t safeTimestamp)
+{
+  timeWarp_t * tw=lc->timeWarp;
+  uint64_t commitTime;
+  if(lc->globalTime<=safeTimestamp)
+  {
+    // All steps are final
+    tw->firstSnapshot=(tw->firstSnapshot+tw->nSnapshots)%tw->maxSnapshots;
+    tw->nSnapshots=0;
+    commitTime=lc->globalTime;
+  }else
+  {
+    // Keep the last snapshot not later than the safe time - a rollback may go back to it but not before
+    while(tw->nSnapshots>1 && timeWarp_getSnapshot(tw, 1)->globalTime<=safeTimestamp)
+    {
+      tw->firstSnapshot=(tw->firstSnapshot+1)%tw->maxSnapshots;
+      tw->nSnapshots--;
+    }
+    assert(tw->nSnapshots>0);
+    commitTime=timeWarp_getSnapshot(tw, 0)->globalTime;
+  }
+  uint32_t offset=0;
+  tw->committing=true;
+  while(offset<tw->outputLogSize)
+  {
+    timeWarp_output_t * output=(timeWarp_output_t *)(tw->outputLog+offset);
+    if(output->generatedAt>commitTime)
+    {
+      break;
+    }
+    timeWarp_output_t * first=output;
+    if(first->nBatch>tw->batchCapacity)
+    {
+      tw->batchData=realloc(tw->batchData, first->nBatch*sizeof(const uint8_t *));
+      tw->batchSizes=realloc(tw->batchSizes, first->nBatch*sizeof(uint32_t));
+      assert(tw->batchData!=NULL && tw->batchSizes!=NULL);
+      tw->batchCapacity=first->nBatch;
+    }
+    // The events of a batch follow each other in the log
+    for(uint32_t i=0;i<first->nBatch;++i)
+    {
+      output=(timeWarp_output_t *)(tw->outputLog+offset);
+      tw->batchData[i]=timeWarp_outputData(output);
+      tw->batchSizes[i]=output->size;
+      offset+=TIME_WARP_OUTPUT_SIZE(output->size, output->nPositions);
+      if(first->nPositions>0)
+      {
+        // Already in the ringbuffers - the readers may consume it once simulatedUntil reaches it
+        channelObject_commitSpeculative(output->co, output->timestamp, tw->batchData[i], output->size);
+      }
+    }
+    if(first->nPositions==0)
+    {
+      // Inserted as one batch so a same timestamp group stays together
+      uint64_t timestamp;
+      if(first->nBatch==1)
+      {
+        timestamp=channelObject_insertEventSized(first->co, first->timestamp, tw->batchData[0], tw->batchSizes[0]);
+      }else
+      {
+        timestamp=channelObject_insertEvents(first->co, first->timestamp, first->nBatch, tw->batchData, tw->batchSizes, first->timestampStep==0);
+      }
+      // The timestamps were delayed when the events were buffered
+      assert(timestamp==output->timestamp);
+      timeWarp_channel(tw, first->co)->nUnsent-=first->nBatch;
+    }
+  }
+  tw->committing=false;
+  if(offset>0)
+  {
+    memmove(tw->outputLog, tw->outputLog+offset, tw->outputLogSize-offset);
+    tw->outputLogSize-=offset;
+    tw->outputCommitted+=offset;
+  }
+  if(commitTime>tw->committedUntil)
+  {
+    tw->committedUntil=commitTime;
+    for(uint32_t i=0;i<lc->nChannelOut;++i)
+    {
+      channelObject_updateTime(lc->channelsOut[i], commitTime);
+    }
+  }
+  // Input events before the oldest snapshot are never processed again
+  timeWarp_snapshot_t * oldest=tw->nSnapshots>0?timeWarp_getSnapshot(tw, 0):NULL;
+  for(uint32_t i=0;i<timeWarp_nInputs(lc);++i)
+  {
+    channelObjectSink_t * sink=timeWarp_input(lc, i);
+    channelObject_releaseSpeculative(sink, oldest!=NULL && i<oldest->nInputs?oldest->inputPositions[i]:channelObjectSink_getSpeculativePosition(sink));
+  }
+}
+
+uint64_t timeWarp_bufferEvent(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size)
+{
+  timestamp=timeWarp_delay(tw, co, timestamp);
+  timeWarp_append(tw, co, timestamp, data, size, 1, 0, timeWarp_canSend(tw, co, 1, size));
+  return timestamp;
+}
+
+uint64_t timeWarp_bufferEvents(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes, bool sameTimestamp)
+{
+  uint32_t timestampStep=sameTimestamp?0:1;
+  uint32_t payloadBytes=0;
+  for(uint32_t i=0;i<nEvents;++i)
+  {
+    payloadBytes+=sizes==NULL?co->messageSize:sizes[i];
+  }
+  timestamp=timeWarp_delay(tw, co, timestamp);
+  bool send=timeWarp_canSend(tw, co, nEvents, payloadBytes);
+  for(uint32_t i=0;i<nEvents;++i)
+  {
+    timeWarp_append(tw, co, timestamp+i*timestampStep, data[i], sizes==NULL?co->messageSize:sizes[i], i==0?nEvents:0, timestampStep, send);
+  }
+  return timestamp+((uint64_t)(nEvents-1))*timestampStep;
+}
+
+static timeWarp_channel_t * timeWarp_channel(timeWarp_t * tw, channelObject_t * co)
+{
+  localClock_t * lc=channelObject_getClock(co);
+  uint32_t index=0;
+  while(index<lc->nChannelOut && lc->channelsOut[index]!=co)
+  {
+    index++;
+  }
+  assertMsg(index<lc->nChannelOut, "Channel %s is not registered to its clock - it is not committed in optimistic mode", co->debugName);
+  if(index>=tw->nChannels)
+  {
+    tw->channels=realloc(tw->channels, lc->nChannelOut*sizeof(timeWarp_channel_t));
+    assert(tw->channels!=NULL);
+    memset(tw->channels+tw->nChannels, 0, (lc->nChannelOut-tw->nChannels)*sizeof(timeWarp_channel_t));
+    tw->nChannels=lc->nChannelOut;
+  }
+  return &(tw->channels[index]);
+}
+
+static uint64_t timeWarp_delay(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp)
+{
+  // The commit inserts the event after the events of the channel buffered before it. The commits between now and the commit of the event
+  // mark the channel simulated until at most the step before the event was generated plus the latency.
+  uint64_t until=co->simulatedUntil;
+  uint64_t buffered=timeWarp_channel(tw, co)->bufferedUntil;
+  if(buffered>until)
+  {
+    until=buffered;
+  }
+  uint64_t generatedAt=channelObject_getClock(co)->globalTime;
+  if(generatedAt>0)
+  {
+    uint64_t committed=generatedAt-1>UINT64_MAX-co->minimalLatency?UINT64_MAX:generatedAt-1+co->minimalLatency;
+    if(committed>until)
+    {
+      until=committed;
+    }
+  }
+  if(timestamp<=until)
+  {
+    // Same as channelObject_insertEventSized() - the event can not be earlier than the simulation of the channel
+    timestamp=until+1;
+  }
+  return timestamp;
+}
+
+static bool timeWarp_canSend(timeWarp_t * tw, channelObject_t * co, uint32_t nEvents, uint32_t payloadBytes)
+{
+  return timeWarp_channel(tw, co)->nUnsent==0 && channelObject_canSendSpeculative(co, nEvents, payloadBytes);
+}
+
+static void timeWarp_append(timeWarp_t * tw, channelObject_t * co, uint64_t timestamp, const uint8_t * data, uint32_t size, uint32_t nBatch, uint32_t timestampStep, bool send)
+{
+  uint32_t nPositions=send?(co->broadcast?1:co->nSink):0;
+  uint32_t entrySize=TIME_WARP_OUTPUT_SIZE(size, nPositions);
+  if(tw->outputLogSize+entrySize>tw->outputLogCapacity)
+  {
+    uint32_t capacity=tw->outputLogCapacity==0?4096:tw->outputLogCapacity;
+    while(capacity<tw->outputLogSize+entrySize)
+    {
+      capacity*=2;
+    }
+    tw->outputLog=realloc(tw->outputLog, capacity);
+    assert(tw->outputLog!=NULL);
+    tw->outputLogCapacity=capacity;
+  }
+  timeWarp_output_t * output=(timeWarp_output_t *)(tw->outputLog+tw->outputLogSize);
+  output->co=co;
+  output->timestamp=timestamp;
+  output->generatedAt=channelObject_getClock(co)->globalTime;
+  output->size=size;
+  output->nBatch=nBatch;
+  output->timestampStep=timestampStep;
+  output->nPositions=nPositions;
+  memcpy(timeWarp_outputData(output), data, size);
+  tw->outputLogSize+=entrySize;
+  timeWarp_channel_t * channel=timeWarp_channel(tw, co);
+  if(timestamp>channel->bufferedUntil)
+  {
+    channel->bufferedUntil=timestamp;
+  }
+  if(nPositions>0)
+  {
+    channelObject_sendSpeculative(co, timestamp, data, size, timeWarp_outputPositions(output));
+  }else
+  {
+    channel->nUnsent++;
+  }
+}
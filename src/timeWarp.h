@@ -0,0 +1,132 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_TIMEWARP_H_
+#define SIMULATOR_TIMEWARP_H_
+
+/// Optimistic execution of a clock (see localClock_setOptimistic()). The clock does not wait for the simulation of its inputs: it advances speculatively
+/// and saves a snapshot of its state before each speculative step. When an input event arrives with a timestamp that is already simulated (straggler)
+/// the state is rolled back to the last snapshot before the event and the simulation is repeated.
+///
+/// The outputs of the clock are sent speculatively: events inserted into the output channels are written into the ringbuffers of the sinks at once
+/// but simulatedUntil of the channel is only moved over them when the step that generated them can not be rolled back any more (commit).
+/// A step can not be rolled back when all inputs are simulated until its time (conservative safe time).
+/// Conservative readers only process the events until simulatedUntil so they never see a speculative event. Optimistic readers process them
+/// speculatively. A rollback cancels the events sent by the dropped steps (anti-messages): they are flagged in the ringbuffers (see CHANNEL_OBJECT_CANCELLED)
+/// and the optimistic readers that already processed them roll back too (see channelObjectSink_takeCancelled()).
+/// An event that does not fit into the free space of the ringbuffers (or follows such an event in its channel) is buffered in the output log
+/// and inserted into the channel at the commit.
+///
+/// Two optimistic clocks coupled in both directions exchange their events ahead of the commit so their expensive steps run in parallel.
+/// The commits still advance with the latency of the channels per handshake (see the localClock_cycle cases of test/benchmark.c).
+
+#include "localClock.h"
+
+/// State of the clock and the model saved before a speculative step
+typedef struct
+{
+  /// Global time of the clock when the snapshot was taken
+  uint64_t globalTime;
+  /// Copy of the timers and the timer heap
+  localClock_timer_t * timers;
+  uint32_t nTimers;
+  uint32_t * timerHeap;
+  uint32_t nTimerHeap;
+  uint32_t freeTimer;
+  bool isrGlobalEnabled;
+  uint64_t isrsFlag;
+  uint64_t isrsEnabled;
+  /// Speculative position of each input sink: simulate inputs then flush inputs
+  uint64_t * inputPositions;
+  uint32_t nInputs;
+  /// Position of the end of the output log - counted from the start of the simulation
+  uint64_t outputPosition;
+  /// Model state saved by the save callback
+  uint8_t * state;
+} timeWarp_snapshot_t;
+
+/// Output channel state of an optimistic clock
+typedef struct
+{
+  /// Latest timestamp in the output log of the channel
+  uint64_t bufferedUntil;
+  /// Number of events of the channel in the output log that were not sent speculatively. The later events are not sent before them to keep the order.
+  uint32_t nUnsent;
+} timeWarp_channel_t;
+
+/// Optimistic execution state of a clock - process local memory
+typedef struct timeWarp_str
+{
+  /// Snapshots ordered by time - a ringbuffer of maxSnapshots
+  timeWarp_snapshot_t * snapshots;
+  uint32_t maxSnapshots;
+  uint32_t firstSnapshot;
+  uint32_t nSnapshots;
+  /// Size of the model state in bytes
+  uint32_t stateSize;
+  localClock_stateCallback_t save;
+  localClock_stateCallback_t restore;
+  void * parameter;
+  /// Events inserted into the output channels and not yet committed. Sequence of timeWarp_output_t each followed by its payload
+  uint8_t * outputLog;
+  uint32_t outputLogSize;
+  uint32_t outputLogCapacity;
+  /// Number of bytes committed and removed from the beginning of the output log since the start of the simulation
+  uint64_t outputCommitted;
+  /// Set while the output log is committed: the events are inserted into the channels
+  bool committing;
+  /// The simulation of the clock is final until this timestamp
+  uint64_t committedUntil;
+  /// State of each output channel - indexed as channelsOut of the clock
+  timeWarp_channel_t * channels;
+  uint32_t nChannels;
+  /// Scratch arrays of the payload pointers and sizes of a batch inserted by the commit
+  const uint8_t ** batchData;
+  uint32_t * batchSizes;
+  uint32_t batchCapacity;
+} timeWarp_t;
+
+/// Allocate the optimistic execution state of the clock
+timeWarp_t * timeWarp_create(uint32_t maxSnapshots, uint32_t stateSize, localClock_stateCallback_t save, localClock_stateCallback_t restore, void * parameter);
+/// Release the memory of the optimistic execution state
+void timeWarp_destroy(timeWarp_t * tw);
+/// Save the state of the clock and the model before a speculative step
+/// @return false when there is no free snapshot - the clock must wait for its inputs
+bool timeWarp_snapshot(localClock_t * lc);
+/// Roll back the state of the clock to the last snapshot earlier than the timestamp of the straggler event. The events sent by the dropped steps are cancelled.
+void timeWarp_rollback(localClock_t * lc, uint64_t timestamp);
+/// Commit the simulation that can not be rolled back: commit the output events sent speculatively, insert the buffered ones into the channels, mark the outputs simulated
+/// and release the input events processed until the commit time.
+/// @param safeTimestamp all inputs are simulated until this timestamp
+void timeWarp_commit(localClock_t * lc, uint64_t safeTimestamp);
+/// Send an event inserted into an output channel of the clock speculatively or buffer it until it is committed. The channel must be registered to the clock.
+/// The timestamp is delayed after the simulation of the channel, after the events of the channel buffered before it and after the latency
+/// from the previous step - the commit can not delay it further.
+/// @return timestamp the event is committed at unless the step is rolled back
+uint64_t timeWarp_bufferEvent(timeWarp_t * tw, struct channelObject_str * co, uint64_t timestamp, const uint8_t * data, uint32_t size);
+/// Send or buffer a batch of events (see channelObject_insertEvents()). The batch is sent or buffered as a whole - a buffered batch is committed with a single
+/// channelObject_insertEvents() so a same timestamp group stays together.
+/// @return timestamp of the last event the batch is committed at unless the step is rolled back
+uint64_t timeWarp_bufferEvents(timeWarp_t * tw, struct channelObject_str * co, uint64_t timestamp, uint32_t nEvents, const uint8_t * const * data, const uint32_t * sizes, bool sameTimestamp);
+
+#endif /* SIMULATOR_TIMEWARP_H_ */
@@ -0,0 +1,208 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "tracer.h"
+#include "assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/// Identifies the trace files
+#define TRACER_MAGIC 0x43525454u
+#define TRACER_VERSION 2
+
+/// Main function of the trace thread
+static void * tracer_threadMain(void * parameter);
+/// Write the staged records into the file
+static void tracer_drain(tracer_t * tracer);
+/// Append data to the file through the mapping
+static void tracer_append(tracer_t * tracer, const uint8_t * data, uint32_t nBytes);
+/// Copy a record into the staging ringbuffer. The caller checked that there is enough space.
+static void tracer_stage(tracer_t * tracer, uint16_t channelId, uint64_t timestamp, const uint8_t * data, uint32_t size);
+
+tracer_t * tracer_create(localClock_t * lc, const char * path, uint32_t stagingSize)
+{
+  assert(lc->tracer==NULL);
+  // The definition of a channel with the longest name must fit
+  assert(stagingSize>=TRACER_RECORD_HEADER_SIZE+MAX_CHANNEL_NAME_LENGTH);
+  tracer_t * tracer=malloc(sizeof(tracer_t));
+  assert(tracer!=NULL);
+  tracer->stagingBuffer=malloc(stagingSize);
+  assert(tracer->stagingBuffer!=NULL);
+  ringBuffer_createPowerOfTwo(&(tracer->staging), stagingSize, tracer->stagingBuffer);
+  tracer->unnotified=0;
+  waitPolicy_initEvent(&(tracer->drainEvent));
+  atomic_init(&(tracer->nDropped), 0);
+  atomic_init(&(tracer->exit), false);
+  tracer->nChannels=0;
+  tracer->fd=open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  assertErrno(tracer->fd>=0);
+  tracer->map=NULL;
+  tracer->mapOffset=0;
+  tracer->fileSize=0;
+  uint32_t header[2]={TRACER_MAGIC, TRACER_VERSION};
+  tracer_append(tracer, (uint8_t *)header, sizeof(header));
+  pthread_t * thread=malloc(sizeof(pthread_t));
+  assert(thread!=NULL);
+  assert(pthread_create(thread, NULL, tracer_threadMain, tracer)==0);
+  tracer->thread=thread;
+  lc->tracer=tracer;
+  return tracer;
+}
+
+void tracer_registerChannel(tracer_t * tracer, channelObject_t * co)
+{
+  assert(channelObject_getClock(co)->tracer==tracer);
+  assert(co->traceId==0 && tracer->nChannels<UINT16_MAX);
+  // Larger events would never fit and would be dropped every time
+  assertMsg(TRACER_RECORD_HEADER_SIZE+co->messageSize<=ringBuffer_getCapacity(&(tracer->staging)), "Events of channel %s do not fit into the staging ringbuffer of the trace", co->debugName);
+  tracer->nChannels++;
+  uint32_t nameLength=strnlen(co->debugName, MAX_CHANNEL_NAME_LENGTH);
+  // Definitions are never dropped - the events of the channel could not be identified
+  while(!ringBuffer_canWrite(&(tracer->staging), TRACER_RECORD_HEADER_SIZE+nameLength))
+  {
+    waitPolicy_notify(&(tracer->drainEvent));
+    waitPolicy_cpuRelax();
+  }
+  tracer_stage(tracer, 0, tracer->nChannels, (uint8_t *)co->debugName, nameLength);
+  co->traceId=tracer->nChannels;
+}
+
+static void tracer_stage(tracer_t * tracer, uint16_t channelId, uint64_t timestamp, const uint8_t * data, uint32_t size)
+{
+  uint8_t header[TRACER_RECORD_HEADER_SIZE];
+  memcpy(header, &timestamp, sizeof(timestamp));
+  memcpy(header+8, &channelId, sizeof(channelId));
+  memcpy(header+10, &size, sizeof(size));
+  ringBuffer_writeReserved(&(tracer->staging), 0, TRACER_RECORD_HEADER_SIZE, header);
+  ringBuffer_writeReserved(&(tracer->staging), TRACER_RECORD_HEADER_SIZE, size, data);
+  ringBuffer_commit(&(tracer->staging), TRACER_RECORD_HEADER_SIZE+size);
+  tracer->unnotified+=TRACER_RECORD_HEADER_SIZE+size;
+  // The trace thread also drains periodically - only wake it early when the ringbuffer fills up
+  if(tracer->unnotified>tracer->staging.bufferSize/2)
+  {
+    tracer->unnotified=0;
+    waitPolicy_notify(&(tracer->drainEvent));
+  }
+}
+
+void tracer_traceEvent(tracer_t * tracer, uint16_t channelId, uint64_t timestamp, const uint8_t * data, uint32_t size)
+{
+  if(ringBuffer_canWrite(&(tracer->staging), TRACER_RECORD_HEADER_SIZE+size))
+  {
+    tracer_stage(tracer, channelId, timestamp, data, size);
+  }else
+  {
+    atomic_fetch_add_explicit(&(tracer->nDropped), 1, memory_order_relaxed);
+  }
+}
+
+uint64_t tracer_getDropped(tracer_t * tracer)
+{
+  return atomic_load_explicit(&(tracer->nDropped), memory_order_relaxed);
+}
+
+static void tracer_append(tracer_t * tracer, const uint8_t * data, uint32_t nBytes)
+{
+  while(nBytes>0)
+  {
+    if(tracer->map==NULL || tracer->fileSize==tracer->mapOffset+TRACER_FILE_CHUNK_SIZE)
+    {
+      if(tracer->map!=NULL)
+      {
+        assertErrno(munmap(tracer->map, TRACER_FILE_CHUNK_SIZE)==0);
+        tracer->mapOffset+=TRACER_FILE_CHUNK_SIZE;
+      }
+      assertErrno(ftruncate(tracer->fd, tracer->mapOffset+TRACER_FILE_CHUNK_SIZE)==0);
+      tracer->map=mmap(NULL, TRACER_FILE_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, tracer->fd, tracer->mapOffset);
+      assertErrno(tracer->map!=MAP_FAILED);
+    }
+    uint64_t at=tracer->fileSize-tracer->mapOffset;
+    uint32_t n=TRACER_FILE_CHUNK_SIZE-at;
+    if(n>nBytes)
+    {
+      n=nBytes;
+    }
+    memcpy(tracer->map+at, data, n);
+    tracer->fileSize+=n;
+    data+=n;
+    nBytes-=n;
+  }
+}
+
+static void tracer_drain(tracer_t * tracer)
+{
+  uint8_t * first;
+  uint8_t * second;
+  uint32_t firstBytes;
+  uint32_t nBytes=ringBuffer_accessReadSpans(&(tracer->staging), &first, &firstBytes, &second);
+  if(nBytes>0)
+  {
+    tracer_append(tracer, first, firstBytes);
+    tracer_append(tracer, second, nBytes-firstBytes);
+    ringBuffer_read(&(tracer->staging), nBytes, NULL);
+  }
+}
+
+static void * tracer_threadMain(void * parameter)
+{
+  tracer_t * tracer=parameter;
+  while(!atomic_load_explicit(&(tracer->exit), memory_order_acquire))
+  {
+    tracer_drain(tracer);
+    uint32_t sequence=waitPolicy_prepareWait(&(tracer->drainEvent));
+    if(ringBuffer_canRead(&(tracer->staging), 1) || atomic_load_explicit(&(tracer->exit), memory_order_acquire))
+    {
+      waitPolicy_cancelWait(&(tracer->drainEvent));
+    }else
+    {
+      // Returns after the timeout at the latest so the staged events are written in time even without notification
+      waitPolicy_wait(&(tracer->drainEvent), sequence);
+    }
+  }
+  tracer_drain(tracer);
+  return NULL;
+}
+
+void tracer_destroy(localClock_t * lc)
+{
+  tracer_t * tracer=lc->tracer;
+  assert(tracer!=NULL);
+  atomic_store_explicit(&(tracer->exit), true, memory_order_release);
+  waitPolicy_notify(&(tracer->drainEvent));
+  assert(pthread_join(*(pthread_t *)tracer->thread, NULL)==0);
+  free(tracer->thread);
+  if(tracer->map!=NULL)
+  {
+    assertErrno(munmap(tracer->map, TRACER_FILE_CHUNK_SIZE)==0);
+  }
+  assertErrno(ftruncate(tracer->fd, tracer->fileSize)==0);
+  assertErrno(close(tracer->fd)==0);
+  free(tracer->stagingBuffer);
+  free(tracer);
+  lc->tracer=NULL;
+}
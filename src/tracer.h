@@ -0,0 +1,84 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#ifndef SIMULATOR_TRACER_H_
+#define SIMULATOR_TRACER_H_
+
+/// Asynchronous binary trace of the events inserted into the channels of a clock.
+///
+/// The insert functions of the traced channels copy each event into a process local staging ringbuffer - no file I/O and no lock on the
+/// simulation thread. A background thread drains the staging ringbuffer into an append only file that is written through a memory mapping.
+/// When the staging ringbuffer is full the event is dropped and counted instead of stalling the simulation (see tracer_getDropped()).
+///
+/// File format: uint32 magic, uint32 version then records of uint64 timestamp, uint16 channel ID, uint32 size and size bytes of payload.
+/// Channel ID 0 is the definition of a channel: the timestamp field is the ID of the channel and the payload is its debugName.
+
+#include "channelObject.h"
+#include "ringBuffer.h"
+#include "waitPolicy.h"
+
+/// Size of the header of the records
+#define TRACER_RECORD_HEADER_SIZE 14
+/// The file is extended and mapped in chunks of this size
+#define TRACER_FILE_CHUNK_SIZE (16u<<20)
+
+/// Trace of the channels of a clock - process local memory
+typedef struct tracer_str
+{
+  /// Written by the simulation thread of the clock, read by the trace thread
+  ringBuffer_t staging;
+  uint8_t * stagingBuffer;
+  /// Bytes written into the staging ringbuffer since the trace thread was last notified - simulation thread only
+  uint32_t unnotified;
+  /// Notified when the staging ringbuffer is half full or the trace is closed
+  waitPolicy_event_t drainEvent;
+  /// Number of events dropped because the staging ringbuffer was full
+  _Atomic uint64_t nDropped;
+  /// Number of channel IDs assigned
+  uint16_t nChannels;
+  /// Trace thread side: the file and the mapped chunk of it
+  int fd;
+  uint8_t * map;
+  uint64_t mapOffset;
+  /// Size of the trace written into the file
+  uint64_t fileSize;
+  _Atomic bool exit;
+  /// The trace thread
+  void * thread;
+} tracer_t;
+
+/// Start tracing the channels of the clock into a file. Starts the trace thread.
+/// @param stagingSize size of the staging ringbuffer in bytes - must be a power of two
+tracer_t * tracer_create(localClock_t * lc, const char * path, uint32_t stagingSize);
+/// Trace the events of the channel. The clock of the channel must be the traced clock. The ID of the channel is written into the trace with its debugName
+/// so the name must be set before. Must be called by the simulation thread of the clock.
+/// The largest event of the channel (messageSize and TRACER_RECORD_HEADER_SIZE) must fit into the staging ringbuffer.
+void tracer_registerChannel(tracer_t * tracer, channelObject_t * co);
+/// Copy an event into the staging ringbuffer - called by the insert functions of the traced channels
+void tracer_traceEvent(tracer_t * tracer, uint16_t channelId, uint64_t timestamp, const uint8_t * data, uint32_t size);
+/// Number of events dropped so far because the trace thread could not keep up
+uint64_t tracer_getDropped(tracer_t * tracer);
+/// Stop the trace thread after all staged events are written and close the file
+void tracer_destroy(localClock_t * lc);
+
+#endif /* SIMULATOR_TRACER_H_ */
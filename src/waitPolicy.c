@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#include "waitPolicy.h"
+#include "assert.h"
+
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static waitPolicy_mode_t mode=WAIT_POLICY_SPIN_THEN_BLOCK;
+static uint32_t spinIterations=WAIT_POLICY_DEFAULT_SPIN_ITERATIONS;
+/// FUTEX_PRIVATE_FLAG when the futex words are only used by the threads of this process
+static int futexFlags=0;
+
+void waitPolicy_set(waitPolicy_mode_t newMode, uint32_t newSpinIterations)
+{
+  mode=newMode;
+  spinIterations=newSpinIterations;
+}
+
+void waitPolicy_setProcessPrivate(bool processPrivate)
+{
+  futexFlags=processPrivate?FUTEX_PRIVATE_FLAG:0;
+}
+
+bool waitPolicy_shouldBlock(uint32_t * iteration)
+{
+  if(mode==WAIT_POLICY_SPIN)
+  {
+    return false;
+  }
+  if(*iteration<spinIterations)
+  {
+    (*iteration)++;
+    return false;
+  }
+  return true;
+}
+
+void waitPolicy_initEvent(waitPolicy_event_t * event)
+{
+  atomic_init(&event->sequence, 0);
+  atomic_init(&event->waiters, 0);
+}
+
+uint32_t waitPolicy_prepareWait(waitPolicy_event_t * event)
+{
+  uint32_t sequence=atomic_load_explicit(&event->sequence, memory_order_acquire);
+  atomic_fetch_add_explicit(&event->waiters, 1, memory_order_relaxed);
+  // Pairs with the fence of waitPolicy_notify(): either the waiter sees the changed condition or the notifier sees the waiter
+  atomic_thread_fence(memory_order_seq_cst);
+  return sequence;
+}
+
+void waitPolicy_wait(waitPolicy_event_t * event, uint32_t sequence)
+{
+  struct timespec timeout;
+  timeout.tv_sec=0;
+  timeout.tv_nsec=WAIT_POLICY_BLOCK_TIMEOUT_MILLIS*1000000l;
+  // Not a private futex by default: the event may be in memory shared by processes. EAGAIN, EINTR and ETIMEDOUT all mean the caller checks the condition again.
+  syscall(SYS_futex, &event->sequence, FUTEX_WAIT | futexFlags, sequence, &timeout, NULL, 0);
+  atomic_fetch_sub_explicit(&event->waiters, 1, memory_order_relaxed);
+}
+
+void waitPolicy_cancelWait(waitPolicy_event_t * event)
+{
+  atomic_fetch_sub_explicit(&event->waiters, 1, memory_order_relaxed);
+}
+
+void waitPolicy_notify(waitPolicy_event_t * event)
+{
+  if(mode==WAIT_POLICY_SPIN)
+  {
+    // Nobody blocks - the fence and the load of the waiters are left out of the hot path of the writers
+    return;
+  }
+  atomic_thread_fence(memory_order_seq_cst);
+  if(atomic_load_explicit(&event->waiters, memory_order_relaxed)>0)
+  {
+    atomic_fetch_add_explicit(&event->sequence, 1, memory_order_release);
+    syscall(SYS_futex, &event->sequence, FUTEX_WAKE | futexFlags, INT_MAX, NULL, NULL, 0);
+  }
+}
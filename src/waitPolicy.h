@@ -0,0 +1,94 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#ifndef SIMULATOR_WAITPOLICY_H_
+#define SIMULATOR_WAITPOLICY_H_
+
+/// Wait policy of the simulator: how a simulator process waits for other processes (for the simulation of an input channel or for space in a ringbuffer).
+/// Spinning has the smallest latency when each simulator has its own CPU core. When there are more simulators than cores then spinning
+/// takes the CPU from the process that is waited for, so after a short spin the waiter blocks on a futex in shared memory until it is notified.
+
+#include "simulator_types.h"
+#include <stdatomic.h>
+
+/// Policy of the waiting loops
+typedef enum
+{
+  /// Spin until the condition is fulfilled. Lowest latency, one CPU core is used while waiting.
+  WAIT_POLICY_SPIN,
+  /// Spin for a limited number of iterations then block on the futex of the waited event. (Default)
+  WAIT_POLICY_SPIN_THEN_BLOCK,
+} waitPolicy_mode_t;
+
+/// Default number of spin iterations before blocking in WAIT_POLICY_SPIN_THEN_BLOCK mode
+#define WAIT_POLICY_DEFAULT_SPIN_ITERATIONS 4096
+/// Blocking wait is limited to this timeout so that the exit flag of the clock and too long waits are still detected
+#define WAIT_POLICY_BLOCK_TIMEOUT_MILLIS 10
+
+/// Futex based wake up point. Must be stored in shared memory when the waiter and the notifier are different processes.
+typedef struct
+{
+  /// Futex word: incremented on each notify that has waiters
+  _Atomic uint32_t sequence;
+  /// Number of waiters that are about to block or are blocked. Notify is a single load while it is 0.
+  _Atomic uint32_t waiters;
+} waitPolicy_event_t;
+
+/// Hint to the CPU that this is an iteration of a spin loop: lowers power use and the penalty of leaving the loop,
+/// and gives the execution resources to the other hyper-thread of the core.
+static inline void waitPolicy_cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/// Set the wait policy of this process. All processes (and threads) sharing channels must use the same mode: in WAIT_POLICY_SPIN mode waitPolicy_notify() does nothing,
+/// so a waiter of another mode blocked on an event of this process is only woken by the WAIT_POLICY_BLOCK_TIMEOUT_MILLIS timeout.
+/// @param spinIterations number of iterations spinning before blocking in WAIT_POLICY_SPIN_THEN_BLOCK mode
+void waitPolicy_set(waitPolicy_mode_t mode, uint32_t spinIterations);
+/// Use process private futex operations. Faster but only valid when all the simulators that share channels with this process are threads
+/// of this process (see localClock_startThread()). Must be set before the simulation is started and in all processes the same way.
+void waitPolicy_setProcessPrivate(bool processPrivate);
+/// Called in each iteration of a waiting loop.
+/// @param iteration counter of the waiting loop - must be 0 before the first iteration
+/// @return true means the waiter should block now: waitPolicy_prepareWait(), check the condition again then waitPolicy_wait() or waitPolicy_cancelWait()
+bool waitPolicy_shouldBlock(uint32_t * iteration);
+/// Initialize the event with no waiters
+void waitPolicy_initEvent(waitPolicy_event_t * event);
+/// Register as a waiter of the event. The waited condition must be checked after this call and before waitPolicy_wait()
+/// otherwise a notify between the check and the wait could be lost.
+/// @return the sequence to be passed to waitPolicy_wait()
+uint32_t waitPolicy_prepareWait(waitPolicy_event_t * event);
+/// Block until the event is notified (or the timeout elapses) and unregister the waiter.
+/// @param sequence the value returned by waitPolicy_prepareWait()
+void waitPolicy_wait(waitPolicy_event_t * event, uint32_t sequence);
+/// Unregister the waiter without blocking - used when the condition became true after waitPolicy_prepareWait()
+void waitPolicy_cancelWait(waitPolicy_event_t * event);
+/// Wake all waiters of the event. Must be called after the waited condition was changed. Does nothing in WAIT_POLICY_SPIN mode - nobody blocks.
+void waitPolicy_notify(waitPolicy_event_t * event);
+
+#endif /* SIMULATOR_WAITPOLICY_H_ */
@@ -0,0 +1,509 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "benchmark.h"
+#include "assert.h"
+#include "ringBuffer.h"
+#include "channelObject.h"
+#include "localClock.h"
+#include "sharedMemory.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+static const uint32_t messageSizes[]={8, 64, 256, 1024};
+static const uint32_t bufferSizes[]={4096, 65536, 1048576};
+
+/// Ringbuffer operation measured by benchmark_ring()
+typedef enum
+{
+  BENCHMARK_RING_WRITE,
+  BENCHMARK_RING_READ,
+  BENCHMARK_RING_PEEK
+} benchmark_ringOperation_t;
+
+/// Ringbuffer variant measured by benchmark_ring()
+typedef enum
+{
+  BENCHMARK_RING_CLASSIC,
+  BENCHMARK_RING_POWER_OF_TWO,
+  BENCHMARK_RING_MIRRORED
+} benchmark_ringMode_t;
+
+/// Collects the latency samples of a single case.
+typedef struct
+{
+  double * samples;
+  uint64_t nSamples;
+  uint64_t operations;
+  uint64_t totalNs;
+} benchmark_stat_t;
+
+static uint64_t benchmark_nanos()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return ((uint64_t)t.tv_sec)*1000000000ull+t.tv_nsec;
+}
+
+static void benchmark_statInit(benchmark_stat_t * stat, uint64_t operations)
+{
+  stat->samples=malloc(sizeof(double)*(operations+1));
+  assert(stat->samples!=NULL);
+  stat->nSamples=0;
+  stat->operations=0;
+  stat->totalNs=0;
+}
+
+static void benchmark_statAdd(benchmark_stat_t * stat, uint64_t startNs, uint64_t nOperations)
+{
+  uint64_t ns=benchmark_nanos()-startNs;
+  stat->samples[stat->nSamples++]=((double)ns)/nOperations;
+  stat->operations+=nOperations;
+  stat->totalNs+=ns;
+}
+
+static int benchmark_compareDouble(const void * a, const void * b)
+{
+  double x=*(const double *)a;
+  double y=*(const double *)b;
+  return (x>y)-(x<y);
+}
+
+/// Fill the statistics of the result and free the samples
+static void benchmark_statFinish(benchmark_stat_t * stat, benchmark_result_t * result, uint64_t bytesPerOperation)
+{
+  assert(stat->nSamples>0);
+  qsort(stat->samples, stat->nSamples, sizeof(double), benchmark_compareDouble);
+  result->operations=stat->operations;
+  result->nsPerOp=((double)stat->totalNs)/stat->operations;
+  result->p50Ns=stat->samples[stat->nSamples/2];
+  result->p99Ns=stat->samples[(stat->nSamples*99)/100];
+  result->mbPerSec=((double)bytesPerOperation*stat->operations)*1000.0/stat->totalNs;
+  free(stat->samples);
+}
+
+static void benchmark_print(FILE * out, benchmark_format_t format, const benchmark_result_t * r, bool first)
+{
+  if(format==BENCHMARK_FORMAT_JSON)
+  {
+    fprintf(out, "%s  {\"benchmark\": \"%s\", \"messageSize\": %u, \"bufferSize\": %u, \"sinks\": %u, \"operations\": %llu, "
+        "\"nsPerOp\": %.2f, \"p50Ns\": %.2f, \"p99Ns\": %.2f, \"mbPerSec\": %.1f}",
+        first ? "" : ",\n", r->name, r->messageSize, r->bufferSize, r->nSink, (unsigned long long)r->operations,
+        r->nsPerOp, r->p50Ns, r->p99Ns, r->mbPerSec);
+  }else
+  {
+    fprintf(out, "%s,%u,%u,%u,%llu,%.2f,%.2f,%.2f,%.1f\n", r->name, r->messageSize, r->bufferSize, r->nSink,
+        (unsigned long long)r->operations, r->nsPerOp, r->p50Ns, r->p99Ns, r->mbPerSec);
+  }
+  fflush(out);
+}
+
+static void benchmark_ring(benchmark_result_t * result, benchmark_ringOperation_t op, benchmark_ringMode_t mode, uint32_t bufferSize, uint32_t messageSize, uint64_t operations)
+{
+  ringBuffer_t rb;
+  uint8_t * buffer=mode==BENCHMARK_RING_MIRRORED ? sharedMemory_allocateMirrored(bufferSize) : malloc(bufferSize);
+  uint8_t * data=malloc(messageSize);
+  assert(buffer!=NULL && data!=NULL);
+  memset(data, 0x5a, messageSize);
+  switch(mode)
+  {
+  case BENCHMARK_RING_CLASSIC:
+    ringBuffer_create(&rb, bufferSize, buffer);
+    break;
+  case BENCHMARK_RING_POWER_OF_TWO:
+    ringBuffer_createPowerOfTwo(&rb, bufferSize, buffer);
+    break;
+  case BENCHMARK_RING_MIRRORED:
+    ringBuffer_createMirrored(&rb, bufferSize, buffer);
+    break;
+  }
+  uint32_t perBatch=ringBuffer_availableWrite(&rb)/messageSize;
+  if(perBatch>BENCHMARK_BATCH)
+  {
+    perBatch=BENCHMARK_BATCH;
+  }
+  assert(perBatch>0);
+  benchmark_stat_t stat;
+  benchmark_statInit(&stat, operations/perBatch);
+  while(stat.operations+perBatch<=operations)
+  {
+    uint64_t start;
+    switch(op)
+    {
+    case BENCHMARK_RING_WRITE:
+      start=benchmark_nanos();
+      for(uint32_t i=0;i<perBatch;++i)
+      {
+        ringBuffer_write(&rb, messageSize, data);
+      }
+      benchmark_statAdd(&stat, start, perBatch);
+      ringBuffer_read(&rb, perBatch*messageSize, NULL);
+      break;
+    case BENCHMARK_RING_READ:
+      for(uint32_t i=0;i<perBatch;++i)
+      {
+        ringBuffer_write(&rb, messageSize, data);
+      }
+      start=benchmark_nanos();
+      for(uint32_t i=0;i<perBatch;++i)
+      {
+        ringBuffer_read(&rb, messageSize, data);
+      }
+      benchmark_statAdd(&stat, start, perBatch);
+      break;
+    case BENCHMARK_RING_PEEK:
+      ringBuffer_write(&rb, messageSize, data);
+      start=benchmark_nanos();
+      for(uint32_t i=0;i<perBatch;++i)
+      {
+        ringBuffer_peek(&rb, messageSize, data);
+      }
+      benchmark_statAdd(&stat, start, perBatch);
+      ringBuffer_read(&rb, messageSize, NULL);
+      break;
+    }
+  }
+  result->messageSize=messageSize;
+  result->bufferSize=bufferSize;
+  result->nSink=0;
+  benchmark_statFinish(&stat, result, messageSize);
+  if(mode==BENCHMARK_RING_MIRRORED)
+  {
+    sharedMemory_freeMirrored(buffer, bufferSize);
+  }else
+  {
+    free(buffer);
+  }
+  free(data);
+}
+
+/// Parameters of the producer thread of benchmark_ringThreads()
+typedef struct
+{
+  ringBuffer_t * rb;
+  uint32_t messageSize;
+  uint64_t nMessages;
+} benchmark_producer_t;
+
+static void * benchmark_producerThread(void * parameter)
+{
+  benchmark_producer_t * p=parameter;
+  uint8_t * data=malloc(p->messageSize);
+  assert(data!=NULL);
+  memset(data, 0, p->messageSize);
+  for(uint64_t i=0;i<p->nMessages;++i)
+  {
+    memcpy(data, &i, sizeof(i)<p->messageSize ? sizeof(i) : p->messageSize);
+    while(!ringBuffer_write(p->rb, p->messageSize, data))
+    {
+      sched_yield();
+    }
+  }
+  free(data);
+  return NULL;
+}
+
+/// Measure the throughput of the ringbuffer when the writer and reader run on different threads.
+/// This is the case when the cache line transfers between the cores dominate the cost.
+static void benchmark_ringThreads(benchmark_result_t * result, uint32_t bufferSize, uint32_t messageSize, uint64_t operations)
+{
+  ringBuffer_t rb;
+  uint8_t * buffer=malloc(bufferSize);
+  uint8_t * data=malloc(messageSize);
+  assert(buffer!=NULL && data!=NULL);
+  ringBuffer_create(&rb, bufferSize, buffer);
+  benchmark_producer_t producer={&rb, messageSize, operations};
+  pthread_t thread;
+  benchmark_stat_t stat;
+  benchmark_statInit(&stat, 1);
+  uint64_t start=benchmark_nanos();
+  assert(pthread_create(&thread, NULL, benchmark_producerThread, &producer)==0);
+  for(uint64_t i=0;i<operations;++i)
+  {
+    while(!ringBuffer_read(&rb, messageSize, data))
+    {
+      sched_yield();
+    }
+    if(messageSize>=sizeof(i))
+    {
+      assert(*((uint64_t *)data)==i);
+    }
+  }
+  pthread_join(thread, NULL);
+  benchmark_statAdd(&stat, start, operations);
+  result->messageSize=messageSize;
+  result->bufferSize=bufferSize;
+  result->nSink=0;
+  benchmark_statFinish(&stat, result, messageSize);
+  free(buffer);
+  free(data);
+}
+
+static void benchmark_eventCallback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  *((uint64_t *)parameter)+=data[0];
+}
+
+/// Measure channelObject_insertEvent() followed by channelObject_processEventsUntil() on all sinks.
+/// @param broadcast use a broadcast channel (single ringbuffer read by all sinks) instead of one ringbuffer per sink
+static void benchmark_channelRoundTrip(benchmark_result_t * result, bool broadcast, uint32_t bufferSize, uint32_t messageSize, uint32_t nSink, uint64_t operations)
+{
+  static localClock_t clock;
+  static channelObject_t co;
+  uint8_t * buffers[MAX_CHANNEL_SINK];
+  uint8_t * readBuffers[MAX_CHANNEL_SINK];
+  channelObjectSink_t * sinks[MAX_CHANNEL_SINK];
+  uint8_t * data=malloc(messageSize);
+  uint64_t received=0;
+  assert(data!=NULL);
+  memset(data, 0x5a, messageSize);
+  localClock_create(&clock, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  memset(buffers, 0, sizeof(buffers));
+  if(broadcast)
+  {
+    buffers[0]=malloc(bufferSize);
+    assert(buffers[0]!=NULL);
+    channelObject_createBroadcast(&co, &clock, messageSize, bufferSize, buffers[0]);
+  }else
+  {
+    channelObject_create(&co, &clock, messageSize);
+  }
+  strcpy(co.debugName, "benchmark");
+  for(uint32_t i=0;i<nSink;++i)
+  {
+    readBuffers[i]=malloc(messageSize+CHANNEL_OBJECT_HEADER_SIZE);
+    assert(readBuffers[i]!=NULL);
+    if(broadcast)
+    {
+      sinks[i]=channelObject_allocateBroadcastSink(&co);
+    }else
+    {
+      buffers[i]=malloc(bufferSize);
+      assert(buffers[i]!=NULL);
+      sinks[i]=channelObject_allocateSink(&co, bufferSize, buffers[i]);
+    }
+    channelObjectSink_setEnabled(sinks[i], true, benchmark_eventCallback, &received, messageSize+CHANNEL_OBJECT_HEADER_SIZE, readBuffers[i]);
+  }
+  benchmark_stat_t stat;
+  benchmark_statInit(&stat, operations/BENCHMARK_BATCH);
+  while(stat.operations+BENCHMARK_BATCH<=operations)
+  {
+    uint64_t start=benchmark_nanos();
+    for(uint32_t i=0;i<BENCHMARK_BATCH;++i)
+    {
+      uint64_t t=channelObject_insertEvent(&co, 0, data);
+      for(uint32_t s=0;s<nSink;++s)
+      {
+        channelObject_processEventsUntil(sinks[s], t);
+      }
+    }
+    benchmark_statAdd(&stat, start, BENCHMARK_BATCH);
+  }
+  assert(received==((uint64_t)stat.operations)*nSink*0x5a);
+  result->messageSize=messageSize;
+  result->bufferSize=bufferSize;
+  result->nSink=nSink;
+  benchmark_statFinish(&stat, result, ((uint64_t)messageSize)*nSink);
+  for(uint32_t i=0;i<nSink;++i)
+  {
+    free(buffers[i]);
+    free(readBuffers[i]);
+  }
+  free(data);
+}
+
+/// Simulated length of a period of the clock cycle cases - also the latency of the channels between the clocks
+#define BENCHMARK_CYCLE_PERIOD 100
+/// Number of simulated periods of the clock cycle cases
+#define BENCHMARK_CYCLE_PERIODS 200
+/// Wall time of the expensive step of a clock. The work is a sleep so the result does not depend on the number of free cores.
+#define BENCHMARK_CYCLE_WORK_NS 200000
+
+/// Two clocks connected by channels in both directions simulated by two threads
+typedef struct
+{
+  localClock_t clocks[2];
+  channelObject_t channels[2];
+  uint8_t buffers[2][4096];
+  uint8_t readBuffers[2][8+CHANNEL_OBJECT_HEADER_SIZE];
+  uint32_t timerParameters[2];
+  uint64_t received;
+} benchmark_cycle_t;
+
+static benchmark_cycle_t * benchmark_cycle;
+
+/// Periodic step of a clock of the cycle: clock 0 works in the even periods and clock 1 in the odd ones
+static void benchmark_cycleTimer(void * parameter)
+{
+  uint32_t index=*((uint32_t *)parameter);
+  uint64_t period=localClock_currentGlobal(&(benchmark_cycle->clocks[index]))/BENCHMARK_CYCLE_PERIOD;
+  if(period%2==index)
+  {
+    struct timespec work={0, BENCHMARK_CYCLE_WORK_NS};
+    nanosleep(&work, NULL);
+  }
+}
+
+static void benchmark_cycleMain(localClock_t * lc, void * parameter)
+{
+  localClock_waitUntilGlobal(lc, BENCHMARK_CYCLE_PERIODS*BENCHMARK_CYCLE_PERIOD);
+}
+
+/// Measure the wall time of a simulated period of two clocks that exchange no events, only the progress of their simulation.
+/// Conservative clocks take turns: each waits for the expensive step of the other. An optimistic clock executes its expensive step
+/// ahead while the other clock works - its outputs are still released at the safe time so only the cheap commit waits for the other clock.
+/// @param optimistic clock 1 runs in optimistic mode
+static void benchmark_clockCycle(benchmark_result_t * result, bool optimistic)
+{
+  benchmark_cycle_t * c=sharedMemory_allocatePrivate(sizeof(benchmark_cycle_t));
+  benchmark_cycle=c;
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_create(&(c->clocks[i]), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  }
+  if(optimistic)
+  {
+    localClock_setOptimistic(&(c->clocks[1]), 8, 0, NULL, NULL, NULL);
+  }
+  for(uint32_t i=0;i<2;++i)
+  {
+    channelObject_create(&(c->channels[i]), &(c->clocks[i]), 8);
+    channelObject_setMinimalLatency(&(c->channels[i]), BENCHMARK_CYCLE_PERIOD);
+    strcpy(c->channels[i].debugName, "benchmarkCycle");
+    localClock_registerChannel(&(c->clocks[i]), &(c->channels[i]));
+    channelObjectSink_t * sink=channelObject_allocateSink(&(c->channels[i]), sizeof(c->buffers[i]), c->buffers[i]);
+    channelObjectSink_setEnabled(sink, true, benchmark_eventCallback, &(c->received), sizeof(c->readBuffers[i]), c->readBuffers[i]);
+    localClock_registerSinkToSimulate(&(c->clocks[1-i]), sink);
+    c->timerParameters[i]=i;
+    localClock_setTimer(&(c->clocks[i]), localClock_allocateTimer(&(c->clocks[i])), true, BENCHMARK_CYCLE_PERIOD, BENCHMARK_CYCLE_PERIOD,
+        benchmark_cycleTimer, &(c->timerParameters[i]));
+  }
+  benchmark_stat_t stat;
+  benchmark_statInit(&stat, 1);
+  uint64_t start=benchmark_nanos();
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_startThread(&(c->clocks[i]), benchmark_cycleMain, NULL);
+  }
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_joinThread(&(c->clocks[i]));
+  }
+  benchmark_statAdd(&stat, start, BENCHMARK_CYCLE_PERIODS);
+  result->messageSize=0;
+  result->bufferSize=0;
+  result->nSink=0;
+  benchmark_statFinish(&stat, result, 0);
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_destroy(&(c->clocks[i]));
+  }
+  sharedMemory_freePrivate(c, sizeof(benchmark_cycle_t));
+}
+
+void benchmark_run(FILE * out, benchmark_format_t format, uint64_t operations)
+{
+  assert(operations>=BENCHMARK_BATCH);
+  static const struct
+  {
+    const char * name;
+    benchmark_ringOperation_t op;
+    benchmark_ringMode_t mode;
+  } ringCases[]={
+      {"ringBuffer_write", BENCHMARK_RING_WRITE, BENCHMARK_RING_CLASSIC},
+      {"ringBuffer_read", BENCHMARK_RING_READ, BENCHMARK_RING_CLASSIC},
+      {"ringBuffer_peek", BENCHMARK_RING_PEEK, BENCHMARK_RING_CLASSIC},
+      {"ringBuffer_write/powerOfTwo", BENCHMARK_RING_WRITE, BENCHMARK_RING_POWER_OF_TWO},
+      {"ringBuffer_read/powerOfTwo", BENCHMARK_RING_READ, BENCHMARK_RING_POWER_OF_TWO},
+      {"ringBuffer_peek/powerOfTwo", BENCHMARK_RING_PEEK, BENCHMARK_RING_POWER_OF_TWO},
+      {"ringBuffer_write/mirrored", BENCHMARK_RING_WRITE, BENCHMARK_RING_MIRRORED},
+      {"ringBuffer_read/mirrored", BENCHMARK_RING_READ, BENCHMARK_RING_MIRRORED},
+      {"ringBuffer_peek/mirrored", BENCHMARK_RING_PEEK, BENCHMARK_RING_MIRRORED},
+  };
+  bool first=true;
+  benchmark_result_t result;
+  if(format==BENCHMARK_FORMAT_JSON)
+  {
+    fprintf(out, "[\n");
+  }else
+  {
+    fprintf(out, "benchmark,messageSize,bufferSize,sinks,operations,nsPerOp,p50Ns,p99Ns,mbPerSec\n");
+  }
+  for(uint32_t c=0;c<sizeof(ringCases)/sizeof(ringCases[0]);++c)
+  {
+    for(uint32_t b=0;b<sizeof(bufferSizes)/sizeof(bufferSizes[0]);++b)
+    {
+      for(uint32_t m=0;m<sizeof(messageSizes)/sizeof(messageSizes[0]);++m)
+      {
+        result.name=ringCases[c].name;
+        benchmark_ring(&result, ringCases[c].op, ringCases[c].mode, bufferSizes[b], messageSizes[m], operations);
+        benchmark_print(out, format, &result, first);
+        first=false;
+      }
+    }
+  }
+  for(uint32_t b=0;b<sizeof(bufferSizes)/sizeof(bufferSizes[0]);++b)
+  {
+    for(uint32_t m=0;m<sizeof(messageSizes)/sizeof(messageSizes[0]);++m)
+    {
+      result.name="ringBuffer_twoThreads";
+      benchmark_ringThreads(&result, bufferSizes[b], messageSizes[m], operations);
+      benchmark_print(out, format, &result, first);
+      first=false;
+    }
+  }
+  for(uint32_t nSink=1;nSink<=MAX_CHANNEL_SINK;++nSink)
+  {
+    for(uint32_t b=0;b<sizeof(bufferSizes)/sizeof(bufferSizes[0]);++b)
+    {
+      for(uint32_t m=0;m<sizeof(messageSizes)/sizeof(messageSizes[0]);++m)
+      {
+        if(messageSizes[m]+CHANNEL_OBJECT_HEADER_SIZE>=bufferSizes[b])
+        {
+          continue;
+        }
+        result.name="channelObject_roundTrip";
+        benchmark_channelRoundTrip(&result, false, bufferSizes[b], messageSizes[m], nSink, operations);
+        benchmark_print(out, format, &result, first);
+        result.name="channelObject_roundTrip/broadcast";
+        benchmark_channelRoundTrip(&result, true, bufferSizes[b], messageSizes[m], nSink, operations);
+        benchmark_print(out, format, &result, false);
+        first=false;
+      }
+    }
+  }
+  result.name="localClock_cycle/conservative";
+  benchmark_clockCycle(&result, false);
+  benchmark_print(out, format, &result, first);
+  result.name="localClock_cycle/optimistic";
+  benchmark_clockCycle(&result, true);
+  benchmark_print(out, format, &result, false);
+  if(format==BENCHMARK_FORMAT_JSON)
+  {
+    fprintf(out, "\n]\n");
+  }
+}
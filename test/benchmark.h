@@ -0,0 +1,72 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+#ifndef SIMULATOR_TEST_BENCHMARK_H_
+#define SIMULATOR_TEST_BENCHMARK_H_
+
+/// Microbenchmarks of the ringBuffer and channelObject hot paths and of the synchronization of clocks.
+/// Results are written as CSV (one row per measured case) or JSON so that runs can be compared by scripts
+/// to catch performance regressions.
+/// Build example: gcc -std=gnu11 -O2 -Isrc -Itest src/*.c test/benchmark.c test/benchmarkMain.c -o benchmark
+
+#include "simulator_types.h"
+#include <stdio.h>
+
+/// Number of operations timed together as one latency sample. A single operation is too short to be timed reliably.
+#define BENCHMARK_BATCH 64
+
+/// Output format of the benchmark results
+typedef enum
+{
+  BENCHMARK_FORMAT_CSV,
+  BENCHMARK_FORMAT_JSON
+} benchmark_format_t;
+
+/// Result of one measured case.
+typedef struct
+{
+  /// Name of the measured operation
+  const char * name;
+  /// Payload size of a single message in bytes
+  uint32_t messageSize;
+  /// Size of the ringbuffer(s) in bytes
+  uint32_t bufferSize;
+  /// Number of enabled sinks (0 for pure ringbuffer cases)
+  uint32_t nSink;
+  /// Number of measured operations
+  uint64_t operations;
+  /// Average time of one operation
+  double nsPerOp;
+  /// Median and 99th percentile of the per operation time measured over small batches of operations
+  double p50Ns;
+  double p99Ns;
+  /// Payload throughput
+  double mbPerSec;
+} benchmark_result_t;
+
+/// Run all benchmark cases and write the results to the output.
+/// @param operations number of operations measured in each case - at least BENCHMARK_BATCH so that each case has a sample. Larger values give more stable results.
+void benchmark_run(FILE * out, benchmark_format_t format, uint64_t operations);
+
+#endif /* SIMULATOR_TEST_BENCHMARK_H_ */
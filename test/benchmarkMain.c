@@ -0,0 +1,66 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+
+/// Command line entry of the benchmark executable.
+/// Usage: benchmark [--json] [--operations N] [--spin]
+/// --spin: use the WAIT_POLICY_SPIN wait policy instead of the default (see waitPolicy.h)
+
+#include "benchmark.h"
+#include "waitPolicy.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char ** argv)
+{
+  benchmark_format_t format=BENCHMARK_FORMAT_CSV;
+  uint64_t operations=1000000;
+  for(int i=1;i<argc;++i)
+  {
+    if(strcmp(argv[i], "--json")==0)
+    {
+      format=BENCHMARK_FORMAT_JSON;
+    }else if(strcmp(argv[i], "--spin")==0)
+    {
+      waitPolicy_set(WAIT_POLICY_SPIN, 0);
+    }else if(strcmp(argv[i], "--operations")==0 && i+1<argc)
+    {
+      char * end;
+      errno=0;
+      operations=strtoull(argv[++i], &end, 10);
+      if(end==argv[i] || *end!='\0' || errno!=0 || argv[i][0]=='-' || operations<BENCHMARK_BATCH)
+      {
+        fprintf(stderr, "Usage: %s [--json] [--operations N] [--spin] - N is a number of at least %u\n", argv[0], BENCHMARK_BATCH);
+        return 1;
+      }
+    }else
+    {
+      fprintf(stderr, "Usage: %s [--json] [--operations N] [--spin]\n", argv[0]);
+      return 1;
+    }
+  }
+  benchmark_run(stdout, format, operations);
+  return 0;
+}
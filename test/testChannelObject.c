@@ -0,0 +1,351 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+
+#include <string.h>
+
+#define MESSAGE_SIZE 6
+/// Not a multiple of the datagram size so that events wrap around the end of the ringbuffer
+#define SINK_BUFFER_SIZE 37
+#define N_SINK 2
+
+/// Collects the events received by a sink
+typedef struct
+{
+  uint32_t nEvents;
+  uint32_t nBatches;
+  uint64_t lastTimestamp;
+  uint32_t lastSize;
+  uint8_t lastData[MESSAGE_SIZE];
+} testChannelObject_received_t;
+
+static localClock_t clock;
+static channelObject_t co;
+static uint8_t sinkBuffers[N_SINK][SINK_BUFFER_SIZE];
+static uint8_t readBuffers[N_SINK][MESSAGE_SIZE+CHANNEL_OBJECT_VARIABLE_HEADER_SIZE];
+static uint8_t writeBuffer[MESSAGE_SIZE];
+static testChannelObject_received_t received[N_SINK];
+static channelObjectSink_t * sinks[N_SINK];
+
+static void testChannelObject_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testChannelObject_received_t * r=parameter;
+  assert(size<=MESSAGE_SIZE);
+  r->nEvents++;
+  r->lastTimestamp=globalTimestamp;
+  r->lastSize=size;
+  memcpy(r->lastData, data, size);
+}
+
+/// Batch callback: dispatches the events of the batch to the per event callback so the same checks apply
+static void testChannelObject_batchCallback(void * parameter, channelObjectSink_t * sink, channelObjectBatch_t * batch)
+{
+  uint64_t timestamp;
+  uint8_t * data;
+  uint32_t size;
+  uint32_t n=0;
+  testChannelObject_received_t * r=parameter;
+  r->nBatches++;
+  while(channelObjectSink_nextBatchEvent(sink, batch, &timestamp, &data, &size))
+  {
+    testChannelObject_callback(parameter, timestamp, sink, data, size);
+    n++;
+  }
+  assert(n==batch->nEvents);
+}
+
+static void testChannelObject_setup(bool broadcast, bool variableLength)
+{
+  localClock_create(&clock, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  if(broadcast)
+  {
+    channelObject_createBroadcast(&co, &clock, MESSAGE_SIZE, SINK_BUFFER_SIZE, sinkBuffers[0]);
+  }else
+  {
+    channelObject_create(&co, &clock, MESSAGE_SIZE);
+  }
+  if(variableLength)
+  {
+    channelObject_setVariableLength(&co);
+  }
+  strcpy(co.debugName, "testChannelObject");
+  channelObject_setWriteBuffer(&co, sizeof(writeBuffer), writeBuffer);
+  for(uint32_t i=0;i<N_SINK;++i)
+  {
+    memset(&received[i], 0, sizeof(received[i]));
+    sinks[i]=broadcast?channelObject_allocateBroadcastSink(&co):channelObject_allocateSink(&co, SINK_BUFFER_SIZE, sinkBuffers[i]);
+    channelObjectSink_setEnabled(sinks[i], true, testChannelObject_callback, &received[i], sizeof(readBuffers[i]), readBuffers[i]);
+  }
+}
+
+/// Events written with insertEvent and with reserve/commit are received the same way - also when they wrap around the end of the ringbuffer.
+static void testChannelObject_reserveCommit()
+{
+  testChannelObject_setup(false, false);
+  for(uint32_t i=0;i<20;++i)
+  {
+    uint64_t t;
+    if(i%2==0)
+    {
+      uint8_t data[MESSAGE_SIZE];
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_insertEvent(&co, 10*(i+1), data);
+    }else
+    {
+      uint8_t * data=channelObject_reserveEvent(&co, 10*(i+1));
+      assert(data!=NULL);
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_commitEvent(&co);
+    }
+    assert(t==10*(i+1));
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t);
+      channelObject_processEventsUntil(sinks[s], t);
+      assert(received[s].nEvents==i+1);
+      assert(received[s].lastTimestamp==t);
+      assert(received[s].lastSize==MESSAGE_SIZE);
+      assert(received[s].lastData[0]==i && received[s].lastData[MESSAGE_SIZE-1]==i);
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==UINT64_MAX);
+    }
+  }
+}
+
+/// Broadcast channel: all sinks receive every event from the single ringbuffer. The second sink reads late so the writer
+/// can only reuse the space read by both sinks.
+static void testChannelObject_broadcast()
+{
+  testChannelObject_setup(true, false);
+  for(uint32_t i=0;i<20;++i)
+  {
+    uint64_t t;
+    if(i%2==0)
+    {
+      uint8_t data[MESSAGE_SIZE];
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_insertEvent(&co, 10*(i+1), data);
+    }else
+    {
+      uint8_t * data=channelObject_reserveEvent(&co, 10*(i+1));
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_commitEvent(&co);
+    }
+    assert(t==10*(i+1));
+    channelObject_processEventsUntil(sinks[0], t);
+    assert(received[0].nEvents==i+1);
+    assert(received[0].lastData[0]==i);
+    if(i%2==1)
+    {
+      channelObject_processEventsUntil(sinks[1], t);
+      assert(received[1].nEvents==i+1);
+      assert(received[1].lastTimestamp==t);
+      assert(received[1].lastData[0]==i && received[1].lastData[MESSAGE_SIZE-1]==i);
+    }
+  }
+  // A re-enabled sink does not receive the events written while it was disabled
+  channelObjectSink_setEnabled(sinks[1], false, testChannelObject_callback, &received[1], sizeof(readBuffers[1]), readBuffers[1]);
+  uint8_t data[MESSAGE_SIZE]={0};
+  channelObject_insertEvent(&co, 1000, data);
+  channelObjectSink_setEnabled(sinks[1], true, testChannelObject_callback, &received[1], sizeof(readBuffers[1]), readBuffers[1]);
+  assert(channelObjectSink_getNextEventTimeStamp(sinks[1])==UINT64_MAX);
+  channelObject_insertEvent(&co, 1010, data);
+  assert(channelObjectSink_getNextEventTimeStamp(sinks[0])==1000);
+  assert(channelObjectSink_getNextEventTimeStamp(sinks[1])==1010);
+}
+
+/// Variable length channel: each sink receives the actual size of the events - also when the events wrap around the end of the ringbuffer.
+static void testChannelObject_variableLength(bool broadcast)
+{
+  testChannelObject_setup(broadcast, true);
+  for(uint32_t i=0;i<30;++i)
+  {
+    uint32_t size=i%(MESSAGE_SIZE+1);
+    uint64_t t;
+    if(i%3==0)
+    {
+      uint8_t * data=channelObject_reserveEvent(&co, 10*(i+1));
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_commitEventSized(&co, size);
+    }else
+    {
+      uint8_t data[MESSAGE_SIZE];
+      memset(data, i, MESSAGE_SIZE);
+      t=channelObject_insertEventSized(&co, 10*(i+1), data, size);
+    }
+    assert(t==10*(i+1));
+    if(i%2==0)
+    {
+      // Two events are in the ringbuffer: the timestamp of the next one is found after the first one is processed
+      continue;
+    }
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t-10);
+      channelObject_processEventsUntil(sinks[s], t-10);
+      assert(received[s].nEvents==i);
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t);
+      channelObject_processEventsUntil(sinks[s], t);
+      assert(received[s].nEvents==i+1);
+      assert(received[s].lastTimestamp==t);
+      assert(received[s].lastSize==size);
+      assert(size==0 || (received[s].lastData[0]==i && received[s].lastData[size-1]==i));
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==UINT64_MAX);
+    }
+  }
+}
+
+/// Batch insert: the events of the batch get the same timestamp or consecutive timestamps and simulatedUntil is the timestamp of the last event.
+static void testChannelObject_insertEvents(bool variableLength)
+{
+  uint8_t payload[3][MESSAGE_SIZE];
+  const uint8_t * data[3]={payload[0], payload[1], payload[2]};
+  // Variable length events are small enough so that 3 of them fit into the ringbuffer
+  const uint32_t sizes[3]={0, 2, 4};
+  uint32_t nEvents=variableLength?3:2;
+  testChannelObject_setup(false, variableLength);
+  for(uint32_t i=0;i<3;++i)
+  {
+    memset(payload[i], i+1, MESSAGE_SIZE);
+  }
+  for(uint32_t round=0;round<6;++round)
+  {
+    bool sameTimestamp=round%2==0;
+    uint64_t t0=co.simulatedUntil+1;
+    uint64_t t=channelObject_insertEvents(&co, 0, nEvents, data, variableLength?sizes:NULL, sameTimestamp);
+    assert(t==(sameTimestamp?t0:t0+nEvents-1));
+    assert(co.simulatedUntil==t);
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      uint32_t before=received[s].nEvents;
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t0);
+      channelObject_processEventsUntil(sinks[s], t0);
+      assert(received[s].nEvents==before+(sameTimestamp?nEvents:1));
+      channelObject_processEventsUntil(sinks[s], t);
+      assert(received[s].nEvents==before+nEvents);
+      assert(received[s].lastTimestamp==t);
+      assert(received[s].lastSize==(variableLength?sizes[nEvents-1]:MESSAGE_SIZE));
+      assert(received[s].lastData[0]==nEvents);
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==UINT64_MAX);
+    }
+  }
+}
+
+/// Batch callback: all events until the timestamp are passed in a single call - also when they wrap around the end of the ringbuffer.
+static void testChannelObject_batch(bool variableLength)
+{
+  testChannelObject_setup(false, variableLength);
+  for(uint32_t s=0;s<N_SINK;++s)
+  {
+    channelObjectSink_setBatchCallback(sinks[s], testChannelObject_batchCallback);
+  }
+  for(uint32_t i=0;i<30;i+=2)
+  {
+    uint8_t data[MESSAGE_SIZE];
+    uint32_t size=variableLength?i%(MESSAGE_SIZE+1):MESSAGE_SIZE;
+    memset(data, i, MESSAGE_SIZE);
+    channelObject_insertEventSized(&co, 10*(i+1), data, MESSAGE_SIZE);
+    uint64_t t=channelObject_insertEventSized(&co, 10*(i+2), data, size);
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      channelObject_processEventsUntil(sinks[s], t);
+      assert(received[s].nEvents==i+2);
+      assert(received[s].nBatches==i/2+1);
+      assert(received[s].lastTimestamp==t);
+      assert(received[s].lastSize==size);
+      assert(size==0 || (received[s].lastData[0]==i && received[s].lastData[size-1]==i));
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==UINT64_MAX);
+    }
+  }
+}
+
+/// Events of an optimistic source: a speculative event is only processed after its commit and a cancelled one is never processed
+/// - also when it is read together with a batch or when only cancelled events are read.
+static void testChannelObject_speculative(bool broadcast, bool batch)
+{
+  testChannelObject_setup(broadcast, true);
+  for(uint32_t s=0;s<N_SINK && batch;++s)
+  {
+    channelObjectSink_setBatchCallback(sinks[s], testChannelObject_batchCallback);
+  }
+  for(uint32_t i=0;i<10;++i)
+  {
+    uint64_t positions[N_SINK];
+    uint8_t data[MESSAGE_SIZE];
+    uint32_t size=i%(MESSAGE_SIZE+1);
+    uint64_t t=co.simulatedUntil+1;
+    memset(data, i, MESSAGE_SIZE);
+    assert(channelObject_canSendSpeculative(&co, 1, MESSAGE_SIZE));
+    channelObject_sendSpeculative(&co, t+1, data, MESSAGE_SIZE, positions);
+    for(uint32_t s=0;s<N_SINK && !batch;++s)
+    {
+      // Not committed - the earliest possible event is after simulatedUntil
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t);
+    }
+    channelObject_cancelSpeculative(&co, t+1, broadcast?1:N_SINK, positions);
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      assert(channelObjectSink_takeCancelled(sinks[s])==t+1);
+      assert(channelObjectSink_takeCancelled(sinks[s])==UINT64_MAX);
+    }
+    assert(channelObject_canSendSpeculative(&co, 1, size));
+    channelObject_sendSpeculative(&co, t+2, data, size, positions);
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      channelObject_processEventsUntilNoWait(sinks[s], t+2);
+      assert(received[s].nEvents==i);
+    }
+    channelObject_commitSpeculative(&co, t+2, data, size);
+    assert(co.simulatedUntil==t+2);
+    for(uint32_t s=0;s<N_SINK;++s)
+    {
+      if(!batch)
+      {
+        assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==t+2);
+      }
+      channelObject_processEventsUntil(sinks[s], t+2);
+      assert(received[s].nEvents==i+1);
+      assert(received[s].lastTimestamp==t+2);
+      assert(received[s].lastSize==size);
+      assert(size==0 || (received[s].lastData[0]==i && received[s].lastData[size-1]==i));
+      assert(channelObjectSink_getNextEventTimeStamp(sinks[s])==UINT64_MAX);
+    }
+  }
+}
+
+void testChannelObject()
+{
+  testChannelObject_reserveCommit();
+  testChannelObject_broadcast();
+  testChannelObject_variableLength(false);
+  testChannelObject_variableLength(true);
+  testChannelObject_insertEvents(false);
+  testChannelObject_insertEvents(true);
+  testChannelObject_batch(false);
+  testChannelObject_batch(true);
+  testChannelObject_speculative(false, false);
+  testChannelObject_speculative(true, false);
+  testChannelObject_speculative(false, true);
+  testChannelObject_speculative(true, true);
+}
@@ -0,0 +1,153 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "checkpoint.h"
+#include "sharedMemory.h"
+#include "testCheckpoint.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define MESSAGE_SIZE 4
+#define SINK_BUFFER_SIZE 128
+#define REGION_PATH "/tmp/testCheckpoint.region"
+#define CLOCK_PATH "/tmp/testCheckpoint.clock"
+
+/// Content of the shared memory region
+typedef struct
+{
+  checkpoint_t checkpoint;
+  channelObject_t co;
+  uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+} testCheckpoint_region_t;
+
+static localClock_t lc;
+static testCheckpoint_region_t * region;
+static uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+/// State of the model
+static uint32_t counter;
+static uint32_t nReceived;
+/// Timer set by index without localClock_allocateTimer() - enabled by the model at runtime
+#define INDEXED_TIMER 5
+static uint32_t nIndexedTimer;
+/// Timer armed by the setup of the process and disabled by the model at runtime
+#define DISARMED_TIMER 3
+/// Timer armed by the setup of the restarted process only - the checkpoint does not have it
+#define LATE_TIMER 9
+static uint32_t nDisarmedTimer;
+
+static void testCheckpoint_indexedTimer(void * parameter)
+{
+  nIndexedTimer++;
+}
+
+static void testCheckpoint_disarmedTimer(void * parameter)
+{
+  nDisarmedTimer++;
+}
+
+static void testCheckpoint_timer(void * parameter)
+{
+  counter++;
+  if(counter==1)
+  {
+    localClock_setTimer(&lc, INDEXED_TIMER, true, 300, 300, testCheckpoint_indexedTimer, NULL);
+    localClock_setTimer(&lc, DISARMED_TIMER, false, 0, 0, testCheckpoint_disarmedTimer, NULL);
+  }
+  channelObject_insertEvent(&(region->co), localClock_currentGlobal(&lc), (uint8_t *)&counter);
+}
+
+static void testCheckpoint_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  nReceived++;
+  assert(value==nReceived);
+  assert(globalTimestamp==100*value);
+}
+
+static void testCheckpoint_save(localClock_t * clock, void * parameter, uint8_t * state)
+{
+  memcpy(state, &counter, sizeof(counter));
+}
+
+static void testCheckpoint_restore(localClock_t * clock, void * parameter, uint8_t * state)
+{
+  memcpy(&counter, state, sizeof(counter));
+}
+
+/// Setup of the process: the clock, the registrations, the timers and the callbacks of the sinks
+static void testCheckpoint_setupProcess()
+{
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_registerChannel(&lc, &(region->co));
+  uint32_t timer=localClock_allocateTimer(&lc);
+  localClock_setTimer(&lc, timer, true, 100, 100, testCheckpoint_timer, NULL);
+  localClock_setTimer(&lc, INDEXED_TIMER, false, 0, 0, testCheckpoint_indexedTimer, NULL);
+  localClock_setTimer(&lc, DISARMED_TIMER, true, 150, 100, testCheckpoint_disarmedTimer, NULL);
+  channelObjectSink_setEnabled(channelObject_getSink(&(region->co), 0), true, testCheckpoint_callback, NULL, sizeof(readBuffer), readBuffer);
+}
+
+void testCheckpoint()
+{
+  region=sharedMemory_allocatePrivate(sizeof(testCheckpoint_region_t));
+  checkpoint_create(&(region->checkpoint), 1);
+  channelObject_create(&(region->co), &lc, MESSAGE_SIZE);
+  channelObject_allocateSink(&(region->co), SINK_BUFFER_SIZE, region->sinkBuffer);
+  testCheckpoint_setupProcess();
+  counter=0;
+  checkpoint_take(&(region->checkpoint), &lc, 250, REGION_PATH, CLOCK_PATH, true, region, sizeof(testCheckpoint_region_t),
+      sizeof(counter), testCheckpoint_save, NULL);
+  // Simulated further after the checkpoint
+  localClock_waitUntilGlobal(&lc, 450);
+  assert(counter==4);
+  // Restore: the region is loaded, the process is set up again then its clock is restored
+  localClock_destroy(&lc);
+  checkpoint_loadRegion(REGION_PATH, region, sizeof(testCheckpoint_region_t));
+  checkpoint_create(&(region->checkpoint), 1);
+  counter=0;
+  testCheckpoint_setupProcess();
+  localClock_setTimer(&lc, LATE_TIMER, true, 300, 100, testCheckpoint_disarmedTimer, NULL);
+  checkpoint_restoreClock(&lc, CLOCK_PATH, sizeof(counter), testCheckpoint_restore, NULL);
+  assert(localClock_currentGlobal(&lc)==250);
+  assert(counter==2);
+  nIndexedTimer=0;
+  nDisarmedTimer=0;
+  // Events of the checkpoint are still in the ringbuffer
+  assert(channelObjectSink_getNextEventTimeStamp(channelObject_getSink(&(region->co), 0))==100);
+  localClock_waitUntilGlobal(&lc, 350);
+  assert(counter==3);
+  // The timer enabled at runtime is restored
+  assert(nIndexedTimer==1);
+  // The timers armed by the setup are disabled as they were at the checkpoint
+  assert(nDisarmedTimer==0);
+  nReceived=0;
+  channelObject_processEventsUntil(channelObject_getSink(&(region->co), 0), 350);
+  assert(nReceived==3);
+  localClock_destroy(&lc);
+  sharedMemory_freePrivate(region, sizeof(testCheckpoint_region_t));
+  unlink(REGION_PATH);
+  unlink(CLOCK_PATH);
+}
@@ -0,0 +1,597 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "sharedMemory.h"
+#include "testLocalClock.h"
+#include "timeCoordinator.h"
+
+#include <string.h>
+#include <sched.h>
+
+#define MESSAGE_SIZE 4
+#define SINK_BUFFER_SIZE 64
+#define N_EVENTS 100
+
+/// Objects of the threaded test - allocated in process local memory
+typedef struct
+{
+  localClock_t source;
+  localClock_t sink;
+  channelObject_t co;
+  uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+  uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+  volatile uint32_t nReceived;
+} testLocalClock_threaded_t;
+
+static void testLocalClock_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testLocalClock_threaded_t * t=parameter;
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  assert(value==t->nReceived);
+  assert(globalTimestamp==100*(value+1));
+  t->nReceived++;
+}
+
+static void testLocalClock_sourceMain(localClock_t * lc, void * parameter)
+{
+  testLocalClock_threaded_t * t=parameter;
+  for(uint32_t i=0;i<N_EVENTS;++i)
+  {
+    channelObject_insertEvent(&(t->co), 100*(i+1), (uint8_t *)&i);
+    localClock_waitUntilGlobal(lc, 100*(i+1));
+  }
+}
+
+static void testLocalClock_sinkMain(localClock_t * lc, void * parameter)
+{
+  // Waits for the source after it finished - left only by exit request
+  localClock_waitUntilGlobal(lc, UINT64_MAX/2);
+  assert(false);
+}
+
+/// Two clocks simulated by two threads of this process connected by a channel in process local memory.
+/// The sink thread received all events and is blocked waiting for the source when exit is requested.
+static void testLocalClock_threaded()
+{
+  testLocalClock_threaded_t * t=sharedMemory_allocatePrivate(sizeof(testLocalClock_threaded_t));
+  localClock_create(&(t->source), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_create(&(t->sink), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_create(&(t->co), &(t->source), MESSAGE_SIZE);
+  strcpy(t->co.debugName, "testLocalClock");
+  localClock_registerChannel(&(t->source), &(t->co));
+  channelObjectSink_t * sink=channelObject_allocateSink(&(t->co), SINK_BUFFER_SIZE, t->sinkBuffer);
+  channelObjectSink_setEnabled(sink, true, testLocalClock_callback, t, sizeof(t->readBuffer), t->readBuffer);
+  localClock_registerSinkToSimulate(&(t->sink), sink);
+  localClock_startThread(&(t->sink), testLocalClock_sinkMain, t);
+  localClock_startThread(&(t->source), testLocalClock_sourceMain, t);
+  localClock_joinThread(&(t->source));
+  while(t->nReceived<N_EVENTS)
+  {
+    sched_yield();
+  }
+  localClock_requestExit(&(t->sink));
+  localClock_joinThread(&(t->sink));
+  assert(t->nReceived==N_EVENTS);
+  localClock_destroy(&(t->source));
+  localClock_destroy(&(t->sink));
+  sharedMemory_freePrivate(t, sizeof(testLocalClock_threaded_t));
+}
+
+#define N_TIMERS 100
+
+/// State of a timer of the timer test
+typedef struct
+{
+  localClock_t * lc;
+  uint32_t index;
+  uint32_t nFired;
+  uint64_t lastFiredAt;
+} testLocalClock_timer_t;
+
+static uint64_t testLocalClock_lastFiredAt;
+
+static void testLocalClock_timerCallback(void * parameter)
+{
+  testLocalClock_timer_t * t=parameter;
+  uint64_t now=localClock_currentGlobal(t->lc);
+  // Timers are executed in order of their timeout
+  assert(now>=testLocalClock_lastFiredAt);
+  // Each timer is executed at most once in a step
+  assert(t->nFired==0 || t->lastFiredAt<now);
+  testLocalClock_lastFiredAt=now;
+  t->lastFiredAt=now;
+  t->nFired++;
+  if(t->index%10==3)
+  {
+    // Stop the periodic timer from its own callback
+    localClock_setTimer(t->lc, t->index, false, 0, 0, NULL, NULL);
+  }
+}
+
+/// More timers than CLOCK_N_TIMERS: one shot, periodic and cancelled timers
+static void testLocalClock_timers()
+{
+  static localClock_t lc;
+  static testLocalClock_timer_t timers[N_TIMERS];
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  testLocalClock_lastFiredAt=0;
+  for(uint32_t i=0;i<N_TIMERS;++i)
+  {
+    uint32_t index=localClock_allocateTimer(&lc);
+    assert(index==i);
+    timers[i].lc=&lc;
+    timers[i].index=index;
+    timers[i].nFired=0;
+    // Periodic timers have a period shorter than the step of the clock in some cases
+    uint64_t period=i%2==0?0:(i%7)*10+1;
+    localClock_setTimer(&lc, index, true, 1000-i*7, period, testLocalClock_timerCallback, &timers[i]);
+  }
+  // Released timers are reused
+  localClock_releaseTimer(&lc, 5);
+  assert(localClock_allocateTimer(&lc)==5);
+  // Cancelled before timeout
+  localClock_setTimer(&lc, 8, false, 0, 0, NULL, NULL);
+  localClock_waitUntilGlobal(&lc, 2000);
+  for(uint32_t i=0;i<N_TIMERS;++i)
+  {
+    uint64_t timeout=1000-i*7;
+    if(i==8)
+    {
+      assert(timers[i].nFired==0);
+    }else if(i%2==0 || i%10==3)
+    {
+      assert(timers[i].nFired==1);
+      assert(timers[i].lastFiredAt==timeout);
+    }else
+    {
+      uint64_t period=(i%7)*10+1;
+      assert(timers[i].nFired==(2000-timeout)/period+1);
+    }
+  }
+  localClock_destroy(&lc);
+}
+
+#define N_INPUTS 20
+#define N_INPUT_EVENTS 10
+#define N_EXTRA_SINKS 6
+#define INPUT_BUFFER_SIZE 256
+
+/// Objects of the many inputs test
+typedef struct
+{
+  localClock_t sink;
+  localClock_t sources[N_INPUTS];
+  channelObject_t channels[N_INPUTS];
+  channelObjectSink_t extraSinks[N_EXTRA_SINKS];
+  uint8_t sinkBuffers[N_INPUTS+N_EXTRA_SINKS-1][INPUT_BUFFER_SIZE];
+  uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+  uint32_t nReceived;
+  uint64_t lastTimestamp;
+} testLocalClock_inputs_t;
+
+static void testLocalClock_inputCallback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testLocalClock_inputs_t * t=parameter;
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  // Events of all inputs are processed in order of their timestamps
+  assert(globalTimestamp==value);
+  assert(globalTimestamp>=t->lastTimestamp);
+  assert(localClock_currentGlobal(&(t->sink))==globalTimestamp);
+  t->lastTimestamp=globalTimestamp;
+  t->nReceived++;
+}
+
+/// More channels and sinks than the initial capacity: the sink clock simulates N_INPUTS channels, the first channel has N_EXTRA_SINKS sinks
+static void testLocalClock_inputs()
+{
+  testLocalClock_inputs_t * t=sharedMemory_allocatePrivate(sizeof(testLocalClock_inputs_t));
+  localClock_create(&(t->sink), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  uint32_t nBuffer=0;
+  for(uint32_t i=0;i<N_INPUTS;++i)
+  {
+    localClock_create(&(t->sources[i]), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+    channelObject_create(&(t->channels[i]), &(t->sources[i]), MESSAGE_SIZE);
+    localClock_registerChannel(&(t->sources[i]), &(t->channels[i]));
+    uint32_t nSink=1;
+    if(i==0)
+    {
+      channelObject_setSinkStorage(&(t->channels[i]), N_EXTRA_SINKS, t->extraSinks);
+      nSink=N_EXTRA_SINKS;
+    }
+    for(uint32_t s=0;s<nSink;++s)
+    {
+      channelObjectSink_t * sink=channelObject_allocateSink(&(t->channels[i]), INPUT_BUFFER_SIZE, t->sinkBuffers[nBuffer++]);
+      channelObjectSink_setEnabled(sink, true, testLocalClock_inputCallback, t, sizeof(t->readBuffer), t->readBuffer);
+      localClock_registerSinkToSimulate(&(t->sink), sink);
+    }
+  }
+  for(uint32_t i=0;i<N_INPUTS;++i)
+  {
+    // Inputs have events at different rates
+    for(uint32_t k=0;k<N_INPUT_EVENTS;++k)
+    {
+      uint32_t timestamp=(k+1)*(i+1)*7+i;
+      channelObject_insertEvent(&(t->channels[i]), timestamp, (uint8_t *)&timestamp);
+    }
+    localClock_waitUntilGlobal(&(t->sources[i]), 10000);
+  }
+  localClock_waitUntilGlobal(&(t->sink), 10000);
+  assert(t->nReceived==(N_INPUTS+N_EXTRA_SINKS-1)*N_INPUT_EVENTS);
+  localClock_destroy(&(t->sink));
+  for(uint32_t i=0;i<N_INPUTS;++i)
+  {
+    localClock_destroy(&(t->sources[i]));
+  }
+  sharedMemory_freePrivate(t, sizeof(testLocalClock_inputs_t));
+}
+
+static void testLocalClock_lookaheadTimer(void * parameter)
+{
+  channelObject_t * co=parameter;
+  uint32_t value=0;
+  channelObject_insertEvent(co, localClock_currentGlobal(channelObject_getClock(co)), (uint8_t *)&value);
+}
+
+/// Lookahead mode: the output is marked to be simulated until the next timer instead of the current time
+static void testLocalClock_lookahead()
+{
+  static localClock_t lc;
+  static channelObject_t co;
+  static uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_create(&co, &lc, MESSAGE_SIZE);
+  channelObject_setMinimalLatency(&co, 10);
+  localClock_registerChannel(&lc, &co);
+  channelObject_allocateSink(&co, SINK_BUFFER_SIZE, sinkBuffer);
+  uint32_t timer=localClock_allocateTimer(&lc);
+  localClock_setTimer(&lc, timer, true, 1000, 1000, testLocalClock_lookaheadTimer, &co);
+  assert(localClock_tryAdvanceTimeGlobal(&lc, 5000)==1000);
+  // Event inserted by the timer at 1000 is delayed by the latency
+  assert(co.simulatedUntil==1010);
+  localClock_setLookahead(&lc, true);
+  assert(localClock_tryAdvanceTimeGlobal(&lc, 5000)==2000);
+  // Nothing happens until the next timeout at 3000
+  assert(co.simulatedUntil==2999+10);
+  localClock_setTimer(&lc, timer, false, 0, 0, NULL, NULL);
+  assert(localClock_tryAdvanceTimeGlobal(&lc, 5000)==5000);
+  assert(co.simulatedUntil==5000+10);
+  // The model may promise no output for a longer time than the latency
+  channelObject_promiseNoEventBefore(&co, 8000);
+  assert(co.simulatedUntil==7999);
+  localClock_waitUntilGlobal(&lc, 6000);
+  assert(co.simulatedUntil==7999);
+  localClock_destroy(&lc);
+}
+
+/// Lookahead mode: the horizon is limited by the flushed inputs too - their events are processed by the clock
+static void testLocalClock_lookaheadFlush()
+{
+  static localClock_t lc;
+  static localClock_t source;
+  static channelObject_t co;
+  static channelObject_t in;
+  static uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+  static uint8_t inBuffer[SINK_BUFFER_SIZE];
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_create(&source, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_create(&co, &lc, MESSAGE_SIZE);
+  channelObject_setMinimalLatency(&co, 10);
+  localClock_registerChannel(&lc, &co);
+  channelObject_allocateSink(&co, SINK_BUFFER_SIZE, sinkBuffer);
+  channelObject_create(&in, &source, MESSAGE_SIZE);
+  localClock_registerSinkToFlush(&lc, channelObject_allocateSink(&in, SINK_BUFFER_SIZE, inBuffer));
+  channelObject_updateTime(&in, 2499);
+  uint32_t timer=localClock_allocateTimer(&lc);
+  localClock_setTimer(&lc, timer, true, 1000, 1000, testLocalClock_lookaheadTimer, &co);
+  localClock_setLookahead(&lc, true);
+  assert(localClock_tryAdvanceTimeGlobal(&lc, 5000)==1000);
+  assert(co.simulatedUntil==1999+10);
+  // An event of the flushed input may arrive at 2501 - before the next timeout at 3000
+  assert(localClock_tryAdvanceTimeGlobal(&lc, 5000)==2000);
+  assert(in.simulatedUntil==2500 && co.simulatedUntil==2499+10);
+  localClock_destroy(&lc);
+  localClock_destroy(&source);
+}
+
+#define IDLE_TIMEOUT 500000000ULL
+#define IDLE_END 1000000000ULL
+
+/// Objects of the idle test: two clocks connected in both directions, attached to a coordinator
+typedef struct
+{
+  timeCoordinator_t coordinator;
+  localClock_t clocks[2];
+  channelObject_t channels[2];
+  uint8_t sinkBuffers[2][SINK_BUFFER_SIZE];
+  uint8_t readBuffers[2][MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+  uint64_t receivedAt[2];
+} testLocalClock_idle_t;
+
+static void testLocalClock_idleCallback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  uint64_t * receivedAt=parameter;
+  *receivedAt=globalTimestamp;
+}
+
+static void testLocalClock_idleTimer(void * parameter)
+{
+  channelObject_t * co=parameter;
+  uint32_t value=0;
+  channelObject_insertEvent(co, localClock_currentGlobal(channelObject_getClock(co))+co->minimalLatency, (uint8_t *)&value);
+}
+
+static void testLocalClock_idleMain(localClock_t * lc, void * parameter)
+{
+  localClock_waitUntilGlobal(lc, IDLE_END);
+}
+
+/// Both clocks are idle until a timer far in the future. Without the coordinator they would advance in steps of the latency of the channels.
+static void testLocalClock_idleCoordinated()
+{
+  testLocalClock_idle_t * t=sharedMemory_allocatePrivate(sizeof(testLocalClock_idle_t));
+  timeCoordinator_create(&(t->coordinator));
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_create(&(t->clocks[i]), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+    localClock_setCoordinator(&(t->clocks[i]), &(t->coordinator));
+    channelObject_create(&(t->channels[i]), &(t->clocks[i]), MESSAGE_SIZE);
+    localClock_registerChannel(&(t->clocks[i]), &(t->channels[i]));
+    t->receivedAt[i]=0;
+  }
+  for(uint32_t i=0;i<2;++i)
+  {
+    channelObjectSink_t * sink=channelObject_allocateSink(&(t->channels[1-i]), SINK_BUFFER_SIZE, t->sinkBuffers[i]);
+    channelObjectSink_setEnabled(sink, true, testLocalClock_idleCallback, &(t->receivedAt[i]), sizeof(t->readBuffers[i]), t->readBuffers[i]);
+    localClock_registerSinkToSimulate(&(t->clocks[i]), sink);
+    uint32_t timer=localClock_allocateTimer(&(t->clocks[i]));
+    localClock_setTimer(&(t->clocks[i]), timer, true, IDLE_TIMEOUT+i, 0, testLocalClock_idleTimer, &(t->channels[i]));
+  }
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_startThread(&(t->clocks[i]), testLocalClock_idleMain, t);
+  }
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_joinThread(&(t->clocks[i]));
+  }
+  assert(t->receivedAt[1]==IDLE_TIMEOUT+1);
+  assert(t->receivedAt[0]==IDLE_TIMEOUT+2);
+  for(uint32_t i=0;i<2;++i)
+  {
+    localClock_destroy(&(t->clocks[i]));
+  }
+  sharedMemory_freePrivate(t, sizeof(testLocalClock_idle_t));
+}
+
+/// Model state of the optimistic test
+typedef struct
+{
+  uint32_t sum;
+  uint32_t ticks;
+} testLocalClock_model_t;
+
+/// Outputs of each tick of the optimistic test: a single event followed by a same timestamp group of two events
+#define TEST_OPTIMISTIC_EVENTS_PER_TICK 3
+
+/// Objects of the optimistic test
+typedef struct
+{
+  localClock_t source;
+  localClock_t clock;
+  channelObject_t in;
+  channelObject_t out;
+  uint8_t inBuffer[SINK_BUFFER_SIZE];
+  uint8_t outBuffer[16*SINK_BUFFER_SIZE];
+  uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+  testLocalClock_model_t model;
+  uint32_t nOutput;
+  /// Timestamps returned by the speculative inserts of each tick - the outputs must be delivered at them
+  uint64_t sentAt[16][TEST_OPTIMISTIC_EVENTS_PER_TICK];
+} testLocalClock_optimistic_t;
+
+static void testLocalClock_saveModel(localClock_t * lc, void * parameter, uint8_t * state)
+{
+  testLocalClock_optimistic_t * t=parameter;
+  memcpy(state, &(t->model), sizeof(t->model));
+}
+
+static void testLocalClock_restoreModel(localClock_t * lc, void * parameter, uint8_t * state)
+{
+  testLocalClock_optimistic_t * t=parameter;
+  memcpy(&(t->model), state, sizeof(t->model));
+}
+
+static void testLocalClock_optimisticInput(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testLocalClock_optimistic_t * t=parameter;
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  t->model.sum+=value;
+}
+
+static void testLocalClock_optimisticTimer(void * parameter)
+{
+  testLocalClock_optimistic_t * t=parameter;
+  t->model.ticks++;
+  uint32_t value=t->model.sum*1000+t->model.ticks;
+  uint64_t now=localClock_currentGlobal(&(t->clock));
+  uint64_t * sentAt=t->sentAt[t->model.ticks];
+  sentAt[0]=channelObject_insertEvent(&(t->out), now+1, (uint8_t *)&value);
+  // Requested at the same timestamp - delayed after the first event and kept together as a group
+  const uint8_t * group[2]={(uint8_t *)&value, (uint8_t *)&value};
+  sentAt[2]=channelObject_insertEvents(&(t->out), now+1, 2, group, NULL, true);
+  sentAt[1]=sentAt[2];
+  assert(sentAt[0]==now+1 && sentAt[2]==now+2);
+}
+
+static void testLocalClock_optimisticOutput(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testLocalClock_optimistic_t * t=parameter;
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  uint32_t tick=t->nOutput/TEST_OPTIMISTIC_EVENTS_PER_TICK+1;
+  // The speculative output computed before the straggler event is cancelled - never delivered
+  assert(value==7000+tick);
+  // Delivered at the timestamp returned by the speculative insert
+  assert(globalTimestamp==t->sentAt[tick][t->nOutput%TEST_OPTIMISTIC_EVENTS_PER_TICK]);
+  t->nOutput++;
+}
+
+/// Create the source and the optimistic clock of the optimistic test. The sink of the output channel is allocated by the caller.
+static void testLocalClock_createOptimistic(testLocalClock_optimistic_t * t)
+{
+  localClock_create(&(t->source), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_create(&(t->clock), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_setOptimistic(&(t->clock), 4, sizeof(testLocalClock_model_t), testLocalClock_saveModel, testLocalClock_restoreModel, t);
+  channelObject_create(&(t->in), &(t->source), MESSAGE_SIZE);
+  channelObject_create(&(t->out), &(t->clock), MESSAGE_SIZE);
+  localClock_registerChannel(&(t->source), &(t->in));
+  localClock_registerChannel(&(t->clock), &(t->out));
+  channelObjectSink_t * in=channelObject_allocateSink(&(t->in), SINK_BUFFER_SIZE, t->inBuffer);
+  channelObjectSink_setEnabled(in, true, testLocalClock_optimisticInput, t, sizeof(t->readBuffer), t->readBuffer);
+  localClock_registerSinkToSimulate(&(t->clock), in);
+  uint32_t timer=localClock_allocateTimer(&(t->clock));
+  localClock_setTimer(&(t->clock), timer, true, 100, 100, testLocalClock_optimisticTimer, t);
+}
+
+/// Optimistic clock: advances ahead of its input, rolls back when an event arrives in the past and delivers its outputs when they are final
+static void testLocalClock_optimistic()
+{
+  testLocalClock_optimistic_t * t=sharedMemory_allocatePrivate(sizeof(testLocalClock_optimistic_t));
+  testLocalClock_createOptimistic(t);
+  channelObjectSink_t * out=channelObject_allocateSink(&(t->out), sizeof(t->outBuffer), t->outBuffer);
+  channelObjectSink_setEnabled(out, true, testLocalClock_optimisticOutput, t, sizeof(t->readBuffer), t->readBuffer);
+  // Speculative step to the first timer - the input is only simulated until 1
+  assert(localClock_tryAdvanceTimeGlobal(&(t->clock), 1000)==100);
+  assert(t->model.ticks==1);
+  // The outputs are sent speculatively - not visible to a conservative reader before the commit
+  assert(channelObjectSink_getNextEventTimeStamp(out)==t->out.simulatedUntil+1);
+  channelObject_processEventsUntilNoWait(out, 1000);
+  assert(t->nOutput==0);
+  // Straggler event
+  uint32_t value=7;
+  channelObject_insertEvent(&(t->in), 50, (uint8_t *)&value);
+  channelObject_updateTime(&(t->in), 60);
+  assert(localClock_tryAdvanceTimeGlobal(&(t->clock), 1000)==0);
+  assert(t->model.ticks==0 && t->model.sum==0);
+  assert(localClock_tryAdvanceTimeGlobal(&(t->clock), 1000)==50);
+  assert(t->model.sum==7);
+  assert(localClock_tryAdvanceTimeGlobal(&(t->clock), 1000)==100);
+  assert(t->model.ticks==1);
+  assert(t->out.simulatedUntil<=51);
+  channelObject_updateTime(&(t->in), 1000);
+  localClock_waitUntilGlobal(&(t->clock), 1000);
+  // The group of the last tick is at 1002
+  assert(t->out.simulatedUntil==1002);
+  channelObject_processEventsUntil(out, 1002);
+  assert(t->nOutput==10*TEST_OPTIMISTIC_EVENTS_PER_TICK);
+  localClock_destroy(&(t->clock));
+  localClock_destroy(&(t->source));
+  sharedMemory_freePrivate(t, sizeof(testLocalClock_optimistic_t));
+}
+
+/// Objects of the cancellation test: the optimistic clock of the optimistic test sends its outputs to an optimistic reader
+typedef struct
+{
+  testLocalClock_optimistic_t writer;
+  localClock_t reader;
+  uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+  /// Model of the reader: sum of the received values and number of the received events
+  testLocalClock_model_t model;
+} testLocalClock_cancel_t;
+
+static void testLocalClock_saveReader(localClock_t * lc, void * parameter, uint8_t * state)
+{
+  testLocalClock_cancel_t * t=parameter;
+  memcpy(state, &(t->model), sizeof(t->model));
+}
+
+static void testLocalClock_restoreReader(localClock_t * lc, void * parameter, uint8_t * state)
+{
+  testLocalClock_cancel_t * t=parameter;
+  memcpy(&(t->model), state, sizeof(t->model));
+}
+
+static void testLocalClock_cancelInput(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  testLocalClock_cancel_t * t=parameter;
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  t->model.sum+=value;
+  t->model.ticks++;
+}
+
+/// Optimistic reader of an optimistic clock: processes the outputs sent speculatively and rolls back when the writer cancels them
+static void testLocalClock_optimisticCancel()
+{
+  testLocalClock_cancel_t * t=sharedMemory_allocatePrivate(sizeof(testLocalClock_cancel_t));
+  testLocalClock_createOptimistic(&(t->writer));
+  localClock_create(&(t->reader), 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_setOptimistic(&(t->reader), 4, sizeof(testLocalClock_model_t), testLocalClock_saveReader, testLocalClock_restoreReader, t);
+  channelObjectSink_t * out=channelObject_allocateSink(&(t->writer.out), sizeof(t->writer.outBuffer), t->writer.outBuffer);
+  channelObjectSink_setEnabled(out, true, testLocalClock_cancelInput, t, sizeof(t->readBuffer), t->readBuffer);
+  localClock_registerSinkToSimulate(&(t->reader), out);
+  // The writer runs ahead of its input and sends the outputs of its first tick
+  assert(localClock_tryAdvanceTimeGlobal(&(t->writer.clock), 1000)==100);
+  assert(t->writer.out.simulatedUntil<101);
+  // The reader processes the first of them speculatively
+  assert(localClock_tryAdvanceTimeGlobal(&(t->reader), 1000)==101);
+  assert(t->model.ticks==1 && t->model.sum==1);
+  // Straggler of the writer - its rollback cancels the events sent by the tick
+  uint32_t value=7;
+  channelObject_insertEvent(&(t->writer.in), 50, (uint8_t *)&value);
+  channelObject_updateTime(&(t->writer.in), 60);
+  assert(localClock_tryAdvanceTimeGlobal(&(t->writer.clock), 1000)==0);
+  assert(atomic_load(&(t->writer.out.nEventsInserted))==0);
+  // The reader rolls back the cancelled event and skips the cancelled events from now on
+  assert(localClock_tryAdvanceTimeGlobal(&(t->reader), 1000)==0);
+  assert(t->model.ticks==0 && t->model.sum==0);
+  assert(channelObjectSink_getNextSpeculativeTimeStamp(out)==UINT64_MAX);
+  channelObject_updateTime(&(t->writer.in), 1000);
+  localClock_waitUntilGlobal(&(t->writer.clock), 1000);
+  // The group of the last tick is at 1002
+  localClock_waitUntilGlobal(&(t->reader), 1002);
+  // Only the events of the repeated ticks are received: 3 events of value 7000+tick at each of the 10 ticks
+  assert(t->model.ticks==10*TEST_OPTIMISTIC_EVENTS_PER_TICK);
+  assert(t->model.sum==TEST_OPTIMISTIC_EVENTS_PER_TICK*(10*7000+55));
+  localClock_destroy(&(t->reader));
+  localClock_destroy(&(t->writer.clock));
+  localClock_destroy(&(t->writer.source));
+  sharedMemory_freePrivate(t, sizeof(testLocalClock_cancel_t));
+}
+
+void testLocalClock()
+{
+  testLocalClock_optimistic();
+  testLocalClock_optimisticCancel();
+  testLocalClock_idleCoordinated();
+  testLocalClock_lookahead();
+  testLocalClock_lookaheadFlush();
+  testLocalClock_threaded();
+  testLocalClock_timers();
+  testLocalClock_inputs();
+}
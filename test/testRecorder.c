@@ -0,0 +1,137 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "recorder.h"
+#include "sharedMemory.h"
+#include "testRecorder.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define MESSAGE_SIZE 4
+#define SINK_BUFFER_SIZE 512
+#define N_EVENTS 16
+/// Events inserted with the same timestamp at the end
+#define GROUP_SIZE 3
+#define N_RECEIVED (N_EVENTS+GROUP_SIZE)
+#define RECORDING_PATH "/tmp/testRecorder.rec"
+
+/// The events received by the model
+typedef struct
+{
+  uint64_t timestamp;
+  uint32_t value;
+  /// Time of the timer of the model when the event was received
+  uint64_t lastTimer;
+} testRecorder_received_t;
+
+static localClock_t lc;
+/// Source of the channel - the peer process of the recording, placeholder of the replay
+static localClock_t sourceClock;
+static channelObject_t * co;
+static uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+static uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+static testRecorder_received_t received[N_RECEIVED];
+static uint32_t nReceived;
+static uint64_t lastTimer;
+
+static void testRecorder_timer(void * parameter)
+{
+  lastTimer=localClock_currentGlobal(&lc);
+}
+
+static void testRecorder_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  assert(nReceived<N_RECEIVED);
+  received[nReceived].timestamp=globalTimestamp;
+  memcpy(&(received[nReceived].value), data, sizeof(uint32_t));
+  received[nReceived].lastTimer=lastTimer;
+  nReceived++;
+}
+
+/// Setup of the process: the clock, the channel, its sink and the timer of the model
+static void testRecorder_setupProcess()
+{
+  localClock_create(&sourceClock, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_create(co, &sourceClock, MESSAGE_SIZE);
+  channelObject_allocateSink(co, SINK_BUFFER_SIZE, sinkBuffer);
+  localClock_registerSinkToSimulate(&lc, channelObject_getSink(co, 0));
+  channelObjectSink_setEnabled(channelObject_getSink(co, 0), true, testRecorder_callback, NULL, sizeof(readBuffer), readBuffer);
+  uint32_t timer=localClock_allocateTimer(&lc);
+  localClock_setTimer(&lc, timer, true, 70, 70, testRecorder_timer, NULL);
+  nReceived=0;
+  lastTimer=0;
+}
+
+void testRecorder()
+{
+  co=sharedMemory_allocatePrivate(sizeof(channelObject_t));
+  testRecorder_setupProcess();
+  recorder_t * rec=recorder_open(&lc, RECORDING_PATH);
+  recorder_attachSink(rec, channelObject_getSink(co, 0));
+  for(uint32_t i=1;i<=N_EVENTS;++i)
+  {
+    channelObject_insertEvent(co, 37*i, (uint8_t *)&i);
+  }
+  uint32_t groupValues[GROUP_SIZE];
+  const uint8_t * group[GROUP_SIZE];
+  for(uint32_t i=0;i<GROUP_SIZE;++i)
+  {
+    groupValues[i]=N_EVENTS+1+i;
+    group[i]=(uint8_t *)&(groupValues[i]);
+  }
+  channelObject_insertEvents(co, 37*(N_EVENTS+1), GROUP_SIZE, group, NULL, true);
+  channelObject_promiseNoEventBefore(co, 1000);
+  localClock_waitUntilGlobal(&lc, 999);
+  recorder_close(&lc);
+  assert(nReceived==N_RECEIVED);
+  testRecorder_received_t recorded[N_RECEIVED];
+  memcpy(recorded, received, sizeof(recorded));
+  localClock_destroy(&lc);
+  localClock_destroy(&sourceClock);
+  // Replay without the source
+  testRecorder_setupProcess();
+  replay_t * rep=replay_open(RECORDING_PATH);
+  replay_attachChannel(rep, co);
+  replay_start(rep);
+  localClock_waitUntilGlobal(&lc, 999);
+  replay_close(rep);
+  assert(nReceived==N_RECEIVED);
+  for(uint32_t i=0;i<N_RECEIVED;++i)
+  {
+    assert(recorded[i].timestamp==received[i].timestamp && recorded[i].value==received[i].value && recorded[i].lastTimer==received[i].lastTimer);
+  }
+  assert(received[N_EVENTS-1].timestamp==37*N_EVENTS && received[N_EVENTS-1].value==N_EVENTS);
+  // The group is replayed with the same timestamp
+  for(uint32_t i=N_EVENTS;i<N_RECEIVED;++i)
+  {
+    assert(received[i].timestamp==37*(N_EVENTS+1) && received[i].value==i+1);
+  }
+  localClock_destroy(&lc);
+  localClock_destroy(&sourceClock);
+  sharedMemory_freePrivate(co, sizeof(channelObject_t));
+  unlink(RECORDING_PATH);
+}
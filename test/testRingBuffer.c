@@ -23,8 +23,76 @@ SOFTWARE.
  */
 #include "assert.h"
 #include "ringBuffer.h"
+#include "sharedMemory.h"
+
+#include <unistd.h>
 
 #define SIZE 27
+#define SIZE_POWER_OF_TWO 16
+
+static void testRingBufferPowerOfTwo()
+{
+  ringBuffer_t rb;
+  uint8_t b[SIZE_POWER_OF_TWO];
+  uint8_t data[SIZE_POWER_OF_TWO];
+  uint8_t out[SIZE_POWER_OF_TWO];
+  for(uint32_t i=0;i<SIZE_POWER_OF_TWO;++i)
+  {
+    data[i]=i;
+  }
+  ringBuffer_createPowerOfTwo(&rb, SIZE_POWER_OF_TWO, b);
+  assert(ringBuffer_availableWrite(&rb)==SIZE_POWER_OF_TWO);
+  assert(ringBuffer_write(&rb, SIZE_POWER_OF_TWO, data));
+  assert(ringBuffer_availableRead(&rb)==SIZE_POWER_OF_TWO);
+  assert(ringBuffer_availableWrite(&rb)==0);
+  assert(!ringBuffer_write(&rb, 1, data));
+  assert(ringBuffer_read(&rb, 10, out));
+  assert(out[9]==9);
+  assert(ringBuffer_write(&rb, 10, data));
+  // Pointers are free running
+  assert(rb.ptrWrite==26);
+  assert(ringBuffer_peekOffset(&rb, 5, 2, out));
+  assert(out[0]==15);
+  assert(out[1]==0);
+  assert(ringBuffer_read(&rb, SIZE_POWER_OF_TWO, out));
+  assert(out[6]==0);
+  assert(out[15]==9);
+  assert(ringBuffer_availableRead(&rb)==0);
+  // Overflow of the 32 bit pointers
+  rb.ptrRead=rb.ptrWrite=rb.cachedRead=rb.cachedWrite=0xfffffffcu;
+  assert(ringBuffer_write(&rb, 8, data));
+  assert(ringBuffer_availableRead(&rb)==8);
+  assert(ringBuffer_read(&rb, 8, out));
+  assert(out[7]==7);
+  assert(rb.ptrRead==4);
+}
+
+/// All data is continuous in a mirrored ringbuffer - also when it wraps around the end of the buffer
+static void testRingBufferMirrored()
+{
+  ringBuffer_t rb;
+  uint32_t size=sysconf(_SC_PAGESIZE);
+  uint8_t * b=sharedMemory_allocateMirrored(size);
+  uint8_t data[SIZE_POWER_OF_TWO];
+  uint8_t * ptr;
+  for(uint32_t i=0;i<SIZE_POWER_OF_TWO;++i)
+  {
+    data[i]=i;
+  }
+  ringBuffer_createMirrored(&rb, size, b);
+  b[0]=1;
+  assert(b[size]==1);
+  assert(ringBuffer_reserve(&rb, size, &ptr)==size);
+  ringBuffer_commit(&rb, size-4);
+  assert(ringBuffer_read(&rb, size-4, NULL));
+  assert(ringBuffer_reserve(&rb, SIZE_POWER_OF_TWO, &ptr)==SIZE_POWER_OF_TWO);
+  assert(ptr==&b[size-4]);
+  assert(ringBuffer_write(&rb, SIZE_POWER_OF_TWO, data));
+  assert(b[0]==4);
+  assert(ringBuffer_accessReadBuffer(&rb, &ptr, SIZE_POWER_OF_TWO)==SIZE_POWER_OF_TWO);
+  assert(ptr[15]==15);
+  sharedMemory_freeMirrored(b, size);
+}
 
 void testRingBuffer()
 {
@@ -32,7 +100,7 @@ void testRingBuffer()
   uint8_t b[SIZE];
   uint8_t data[SIZE];
   ringBuffer_create(&rb, SIZE, b);
-  assert(rb.buffer==b);
+  assert(ringBuffer_getBuffer(&rb)==b);
   assert(rb.bufferSize==SIZE);
   assert(rb.ptrRead==0);
   assert(rb.ptrWrite==0);
@@ -50,4 +118,6 @@ void testRingBuffer()
   assert(ringBuffer_read(&rb, 1, data));
   assert(ringBuffer_write(&rb, 1, data));
   assert(rb.ptrWrite==0);
+  testRingBufferPowerOfTwo();
+  testRingBufferMirrored();
 }
@@ -0,0 +1,201 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "sharedArena.h"
+#include "sharedMemory.h"
+#include "testSharedArena.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#define REGION_SIZE (1<<20)
+#define REGION_NAME "/testSharedArena"
+#define MESSAGE_SIZE 4
+#define SINK_BUFFER_SIZE 128
+/// Region of the backing options test - not a multiple of the page size
+#define OPTIONS_REGION_SIZE (REGION_SIZE+100)
+#define OPTIONS_REGION_NAME "/testSharedArenaOptions"
+/// tmpfs stands in for hugetlbfs: its files are allocated in base pages so the rounding is to the base page size
+#define OPTIONS_HUGETLBFS "/dev/shm"
+#define OPTIONS_CHECKPOINT "/tmp/testSharedArena.region"
+
+static uint32_t nReceived;
+
+static void testSharedArena_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  assert(value==42 && globalTimestamp==10);
+  nReceived++;
+}
+
+/// Locked memory of the process in kB
+static uint64_t testSharedArena_lockedKb()
+{
+  FILE * f=fopen("/proc/self/status", "r");
+  assertErrno(f!=NULL);
+  char line[256];
+  unsigned long kb=0;
+  while(fgets(line, sizeof(line), f)!=NULL)
+  {
+    if(sscanf(line, "VmLck: %lu kB", &kb)==1)
+    {
+      break;
+    }
+  }
+  fclose(f);
+  return kb;
+}
+
+/// Number of resident pages of a mapping
+static uint64_t testSharedArena_residentPages(void * address, uint64_t sizeBytes)
+{
+  long pageSize=sysconf(_SC_PAGESIZE);
+  uint64_t nPages=(sizeBytes+pageSize-1)/pageSize;
+  unsigned char * vec=malloc(nPages);
+  assert(vec!=NULL);
+  assertErrno(mincore(address, sizeBytes, vec)==0);
+  uint64_t resident=0;
+  for(uint64_t i=0;i<nPages;++i)
+  {
+    resident+=vec[i]&1;
+  }
+  free(vec);
+  return resident;
+}
+
+/// Huge page backing (rounding, restore and mirroring through the hugetlbfs object), locking and prefaulting of the region
+static void testSharedArena_options()
+{
+  setenv("SIMULATOR_HUGETLBFS", OPTIONS_HUGETLBFS, 1);
+  // Left by an aborted run - the pages of the new object must not be resident yet
+  unlink(OPTIONS_HUGETLBFS OPTIONS_REGION_NAME);
+  struct statfs fs;
+  assertErrno(statfs(OPTIONS_HUGETLBFS, &fs)==0);
+  uint64_t pageSize=fs.f_bsize;
+  uint64_t objectSize=(OPTIONS_REGION_SIZE+pageSize-1)/pageSize*pageSize;
+  uint64_t lockedBefore=testSharedArena_lockedKb();
+  uint8_t * region=sharedMemory_openWithOptions(OPTIONS_REGION_NAME, OPTIONS_REGION_SIZE, true, SHARED_MEMORY_HUGE_PAGES | SHARED_MEMORY_LOCK);
+  // The object is a file of the mount point rounded up to whole pages and the whole mapping is locked
+  struct stat st;
+  assertErrno(stat(OPTIONS_HUGETLBFS OPTIONS_REGION_NAME, &st)==0);
+  assert((uint64_t)st.st_size==objectSize && objectSize>OPTIONS_REGION_SIZE);
+  assert(testSharedArena_lockedKb()-lockedBefore>=objectSize/1024);
+  assert(testSharedArena_residentPages(region, objectSize)==objectSize/sysconf(_SC_PAGESIZE));
+  // The mirror maps the same hugetlbfs object
+  region[pageSize]=0x5a;
+  sharedMemory_mirrorRangeWithOptions(OPTIONS_REGION_NAME, region, pageSize, pageSize, SHARED_MEMORY_HUGE_PAGES);
+  assert(region[2*pageSize]==0x5a);
+  region[2*pageSize+1]=0xa5;
+  assert(region[pageSize+1]==0xa5);
+  munmap(region, objectSize);
+  assert(testSharedArena_lockedKb()==lockedBefore);
+  // Restore replaces the hugetlbfs object with the content of the region file
+  uint8_t * content=malloc(OPTIONS_REGION_SIZE);
+  assert(content!=NULL);
+  for(uint32_t i=0;i<OPTIONS_REGION_SIZE;++i)
+  {
+    content[i]=(uint8_t)(i*7);
+  }
+  FILE * f=fopen(OPTIONS_CHECKPOINT, "w");
+  assertErrno(f!=NULL);
+  assert(fwrite(content, 1, OPTIONS_REGION_SIZE, f)==OPTIONS_REGION_SIZE);
+  fclose(f);
+  region=sharedMemory_restoreWithOptions(OPTIONS_REGION_NAME, OPTIONS_CHECKPOINT, OPTIONS_REGION_SIZE, SHARED_MEMORY_HUGE_PAGES);
+  assertErrno(stat(OPTIONS_HUGETLBFS OPTIONS_REGION_NAME, &st)==0);
+  assert((uint64_t)st.st_size==objectSize);
+  assert(memcmp(region, content, OPTIONS_REGION_SIZE)==0 && region[objectSize-1]==0);
+  munmap(region, objectSize);
+  free(content);
+  unlink(OPTIONS_CHECKPOINT);
+  unlink(OPTIONS_HUGETLBFS OPTIONS_REGION_NAME);
+  unsetenv("SIMULATOR_HUGETLBFS");
+  // A new region has no page until it is used - prefault allocates all of them
+  region=sharedMemory_open(OPTIONS_REGION_NAME, REGION_SIZE, true);
+  assert(testSharedArena_residentPages(region, REGION_SIZE)==0);
+  sharedMemory_prefault(region, REGION_SIZE);
+  assert(testSharedArena_residentPages(region, REGION_SIZE)==REGION_SIZE/sysconf(_SC_PAGESIZE));
+  munmap(region, REGION_SIZE);
+  shm_unlink(OPTIONS_REGION_NAME);
+}
+
+void testSharedArena()
+{
+  testSharedArena_options();
+  localClock_t lc;
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  // The region is mapped twice to different addresses - the same as two processes mapping it
+  void * region=sharedMemory_openWithOptions(REGION_NAME, REGION_SIZE, true, SHARED_MEMORY_TRANSPARENT_HUGE_PAGES | SHARED_MEMORY_PREFAULT);
+  void * mapped=sharedMemory_open(REGION_NAME, REGION_SIZE, false);
+  assert(region!=mapped && ((uintptr_t)region)%(2u<<20)==0);
+  // Master: setup
+  sharedArena_t * arena=sharedArena_create(region, REGION_SIZE);
+  // The clock of the source is in the region so the readers can access it
+  localClock_t * source=sharedArena_allocate(arena, sizeof(localClock_t));
+  localClock_create(source, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_t * co=sharedArena_allocateNamed(arena, "channel", sizeof(channelObject_t));
+  uint8_t * sinkBuffer=sharedArena_allocateNamed(arena, "channel.sink", SINK_BUFFER_SIZE);
+  uint8_t * readBuffer=sharedArena_allocateNamed(arena, "channel.read", MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE);
+  uint8_t * page=sharedArena_allocateAligned(arena, 1, sysconf(_SC_PAGESIZE));
+  assert(((uintptr_t)co)%SIMULATOR_CACHE_LINE_SIZE==0 && ((uintptr_t)sinkBuffer)%SIMULATOR_CACHE_LINE_SIZE==0);
+  assert(((uintptr_t)readBuffer)%SIMULATOR_CACHE_LINE_SIZE==0 && ((uintptr_t)page)%sysconf(_SC_PAGESIZE)==0);
+  channelObject_create(co, source, MESSAGE_SIZE);
+  channelObject_allocateSink(co, SINK_BUFFER_SIZE, sinkBuffer);
+  sharedArena_publish(arena);
+  // Other process: lookup by name in its own mapping
+  sharedArena_t * attached=sharedArena_attach(mapped);
+  channelObject_t * found=sharedArena_find(attached, "channel");
+  assert(sharedArena_offsetOf(attached, found)==sharedArena_offsetOf(arena, co) && sharedArena_offsetOf(attached, found)>=sizeof(sharedArena_t));
+  assert(sharedArena_find(attached, "missing")==NULL);
+  // Relative pointers resolve inside the mapping they are read from
+  assert(channelObject_getClock(found)==(localClock_t *)((uint8_t *)mapped+sharedArena_offsetOf(arena, source)));
+  assert(ringBuffer_getBuffer(&(channelObject_getSink(found, 0)->buffer))==sharedArena_find(attached, "channel.sink"));
+  localClock_registerSinkToSimulate(&lc, channelObject_getSink(found, 0));
+  // Only a hint - fails only without NUMA support in the kernel. An unknown node is rejected.
+  int node=sharedMemory_currentNode();
+  errno=0;
+  bool bound=localClock_bindInputsToNode(&lc, node);
+  assert(node<0?!bound:(bound || errno==ENOSYS));
+  assert(!localClock_bindInputsToNode(&lc, -1) && !sharedMemory_bindToNode(page, 1, 64));
+  channelObjectSink_setEnabled(channelObject_getSink(found, 0), true, testSharedArena_callback, NULL, MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE,
+      sharedArena_find(attached, "channel.read"));
+  uint32_t value=42;
+  nReceived=0;
+  channelObject_insertEvent(co, 10, (uint8_t *)&value);
+  channelObject_updateTime(co, 20);
+  localClock_waitUntilGlobal(&lc, 20);
+  assert(nReceived==1);
+  localClock_destroy(&lc);
+  localClock_destroy(source);
+  munmap(mapped, REGION_SIZE);
+  munmap(region, REGION_SIZE);
+  shm_unlink(REGION_NAME);
+}
@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "sharedMemory.h"
+#include "tracer.h"
+#include "testTracer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MESSAGE_SIZE 4
+#define STAGING_SIZE 4096
+#define N_EVENTS 100
+#define TRACE_PATH "/tmp/testTracer.trace"
+#define CHANNEL_NAME "traced"
+
+/// Read a record header from the trace file
+static void testTracer_readRecord(FILE * file, uint64_t * timestamp, uint16_t * channelId, uint32_t * size)
+{
+  assert(fread(timestamp, sizeof(*timestamp), 1, file)==1);
+  assert(fread(channelId, sizeof(*channelId), 1, file)==1);
+  assert(fread(size, sizeof(*size), 1, file)==1);
+}
+
+void testTracer()
+{
+  localClock_t lc;
+  localClock_create(&lc, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_t * co=sharedMemory_allocatePrivate(sizeof(channelObject_t));
+  channelObject_create(co, &lc, MESSAGE_SIZE);
+  strcpy(co->debugName, CHANNEL_NAME);
+  localClock_registerChannel(&lc, co);
+  tracer_t * tracer=tracer_create(&lc, TRACE_PATH, STAGING_SIZE);
+  tracer_registerChannel(tracer, co);
+  for(uint32_t i=0;i<N_EVENTS;++i)
+  {
+    channelObject_insertEvent(co, 10*(i+1), (uint8_t *)&i);
+  }
+  assert(tracer_getDropped(tracer)==0);
+  tracer_destroy(&lc);
+  FILE * file=fopen(TRACE_PATH, "rb");
+  assert(file!=NULL);
+  uint32_t header[2];
+  assert(fread(header, sizeof(header), 1, file)==1);
+  uint64_t timestamp;
+  uint16_t channelId;
+  uint32_t size;
+  char name[sizeof(CHANNEL_NAME)];
+  testTracer_readRecord(file, &timestamp, &channelId, &size);
+  assert(channelId==0 && timestamp==co->traceId && size==strlen(CHANNEL_NAME));
+  assert(fread(name, size, 1, file)==1);
+  assert(memcmp(name, CHANNEL_NAME, size)==0);
+  for(uint32_t i=0;i<N_EVENTS;++i)
+  {
+    uint32_t value;
+    testTracer_readRecord(file, &timestamp, &channelId, &size);
+    assert(channelId==co->traceId && timestamp==10*(i+1) && size==MESSAGE_SIZE);
+    assert(fread(&value, sizeof(value), 1, file)==1);
+    assert(value==i);
+  }
+  assert(fgetc(file)==EOF);
+  fclose(file);
+  localClock_destroy(&lc);
+  sharedMemory_freePrivate(co, sizeof(channelObject_t));
+  unlink(TRACE_PATH);
+}
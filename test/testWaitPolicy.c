@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2023 Q-Gears Kft., Hungary
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+ */
+#include "assert.h"
+#include "channelObject.h"
+#include "testWaitPolicy.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#define MESSAGE_SIZE 6
+/// Only two events fit into the ringbuffer so the source blocks on the sink
+#define SINK_BUFFER_SIZE 37
+#define N_EVENTS 200
+
+static localClock_t localClock;
+static channelObject_t co;
+static channelObjectSink_t * sink;
+static uint8_t sinkBuffer[SINK_BUFFER_SIZE];
+static uint8_t readBuffer[MESSAGE_SIZE+CHANNEL_OBJECT_HEADER_SIZE];
+static uint32_t nReceived;
+
+static void testWaitPolicy_callback(void * parameter, uint64_t globalTimestamp, channelObjectSink_t * sink, uint8_t * data, uint32_t size)
+{
+  assert(globalTimestamp==10*(nReceived+1));
+  assert(data[0]==(uint8_t)nReceived);
+  nReceived++;
+}
+
+static void * testWaitPolicy_source(void * parameter)
+{
+  for(uint32_t i=0;i<N_EVENTS;++i)
+  {
+    uint8_t data[MESSAGE_SIZE];
+    memset(data, i, MESSAGE_SIZE);
+    assert(channelObject_insertEvent(&co, 10*(i+1), data)==10*(i+1));
+  }
+  return NULL;
+}
+
+void testWaitPolicy()
+{
+  pthread_t source;
+  // Block immediately so that both the futex wait and the wake up are exercised
+  waitPolicy_set(WAIT_POLICY_SPIN_THEN_BLOCK, 0);
+  localClock_create(&localClock, 0, BASE_MULTIPLIER, BASE_MULTIPLIER, BASE_MULTIPLIER, 0);
+  channelObject_create(&co, &localClock, MESSAGE_SIZE);
+  strcpy(co.debugName, "testWaitPolicy");
+  nReceived=0;
+  sink=channelObject_allocateSink(&co, SINK_BUFFER_SIZE, sinkBuffer);
+  channelObjectSink_setEnabled(sink, true, testWaitPolicy_callback, NULL, sizeof(readBuffer), readBuffer);
+  assert(pthread_create(&source, NULL, testWaitPolicy_source, NULL)==0);
+  for(uint32_t i=0;i<N_EVENTS;++i)
+  {
+    channelObject_processEventsUntil(sink, 10*(i+1));
+    assert(nReceived==i+1);
+  }
+  assert(pthread_join(source, NULL)==0);
+  waitPolicy_set(WAIT_POLICY_SPIN_THEN_BLOCK, WAIT_POLICY_DEFAULT_SPIN_ITERATIONS);
+}